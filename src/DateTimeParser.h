@@ -5,6 +5,8 @@
 #include "LocaleInfo.h"
 #include <Rcpp.h>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 
 // Parsing ---------------------------------------------------------------------
@@ -48,7 +50,7 @@ inline bool parseDouble(
   char* endp;
 
   errno = 0;
-  res = strtol(buf, &endp, 10);
+  res = strtod(buf, &endp);
   if (errno > 0)
     res = NA_REAL;
 
@@ -56,6 +58,227 @@ inline bool parseDouble(
   return res != NA_REAL;
 }
 
+// A date time format string compiled into a flat sequence of parsing
+// operations. Formats are validated and compiled once per column, so parsing
+// each value only needs to walk the operations rather than re-interpreting the
+// format string. Compound formats (%D, %F, %R, %T, %X, %x) are expanded inline.
+class DateTimeFormat {
+public:
+  enum op_type {
+    WHITESPACE,
+    LITERAL,
+    YEAR,
+    YEAR_SHORT,
+    MONTH,
+    MONTH_ABBREV,
+    MONTH_NAME,
+    DAY,
+    DAY_ABBREV,
+    DAY_SPACE,
+    HOUR,
+    HOUR12,
+    MINUTE,
+    SECONDS,
+    PARTIAL_SECONDS,
+    AM_PM,
+    TZ_OFFSET,
+    TZ_NAME,
+    NON_DIGIT,
+    NON_DIGITS,
+    ANY_NON_DIGITS,
+    AUTO_DATE,
+    AUTO_TIME
+  };
+
+  struct op {
+    op_type type;
+    char value;
+  };
+
+  // Formats which only match the fixed width layouts YYYY-MM-DD and
+  // YYYY-MM-DD HH:MM:SS, which have a fast path in DateTimeParser.
+  enum layout_type {
+    VARIABLE_LAYOUT,
+    FIXED_DATE,
+    FIXED_DATETIME,
+    FIXED_DATETIME_PARTIAL
+  };
+
+  DateTimeFormat(const std::string& format)
+      : iso8601_(false), layout_(VARIABLE_LAYOUT) {
+    compile(format);
+
+    if (format == "%Y-%m-%d" || format == "%F" || format == "%AD") {
+      layout_ = FIXED_DATE;
+    } else if (
+        format == "%Y-%m-%d %H:%M:%S" || format == "%F %T" ||
+        format == "%F %X") {
+      layout_ = FIXED_DATETIME;
+    } else if (format == "%Y-%m-%d %H:%M:%OS") {
+      layout_ = FIXED_DATETIME_PARTIAL;
+    }
+  }
+
+  // The format used when none is given for date times
+  static DateTimeFormat ISO8601() {
+    DateTimeFormat out("");
+    out.iso8601_ = true;
+    return out;
+  }
+
+  bool isISO8601() const { return iso8601_; }
+
+  layout_type layout() const { return layout_; }
+
+  const std::vector<op>& ops() const { return ops_; }
+
+private:
+  std::vector<op> ops_;
+  bool iso8601_;
+  layout_type layout_;
+
+  void push(op_type type, char value = '\0') {
+    // Consecutive whitespace matches the same as a single whitespace
+    if (type == WHITESPACE && !ops_.empty() && ops_.back().type == WHITESPACE) {
+      return;
+    }
+    ops_.push_back({type, value});
+  }
+
+  void compile_compound(const std::string& format) {
+    push(WHITESPACE);
+    compile(format);
+    push(WHITESPACE);
+  }
+
+  void compile(const std::string& format) {
+    std::string::const_iterator formatItr, formatEnd = format.end();
+    for (formatItr = format.begin(); formatItr != formatEnd; ++formatItr) {
+      // Whitespace in format matches 0 or more whitespace in date
+      if (std::isspace(*formatItr)) {
+        push(WHITESPACE);
+        continue;
+      }
+
+      // Any other characters must much exactly.
+      if (*formatItr != '%') {
+        push(LITERAL, *formatItr);
+        continue;
+      }
+
+      if (formatItr + 1 == formatEnd)
+        Rcpp::stop("Invalid format: trailing %");
+      formatItr++;
+
+      switch (*formatItr) {
+      case 'Y': // year with century
+        push(YEAR);
+        break;
+      case 'y': // year without century
+        push(YEAR_SHORT);
+        break;
+      case 'm': // month
+        push(MONTH);
+        break;
+      case 'b': // abbreviated month name
+        push(MONTH_ABBREV);
+        break;
+      case 'B': // month name
+        push(MONTH_NAME);
+        break;
+      case 'd': // day
+        push(DAY);
+        break;
+      case 'a': // abbreviated day of week
+        push(DAY_ABBREV);
+        break;
+      case 'e': // day with optional leading space
+        push(DAY_SPACE);
+        break;
+      case 'H': // hour
+        push(HOUR);
+        break;
+      case 'I': // hour
+        push(HOUR12);
+        break;
+      case 'M': // minute
+        push(MINUTE);
+        break;
+      case 'S': // seconds (integer)
+        push(SECONDS);
+        break;
+      case 'O': // seconds (double)
+        if (formatItr + 1 == formatEnd || *(formatItr + 1) != 'S')
+          Rcpp::stop("Invalid format: %%O must be followed by %%S");
+        formatItr++;
+        push(PARTIAL_SECONDS);
+        break;
+
+      case 'p': // AM/PM
+        push(AM_PM);
+        break;
+
+      case 'z': // time zone specification
+        push(TZ_OFFSET);
+        break;
+      case 'Z': // time zone name
+        push(TZ_NAME);
+        break;
+
+      // Extensions
+      case '.':
+        push(NON_DIGIT);
+        break;
+
+      case '+':
+        push(NON_DIGITS);
+        break;
+
+      case '*':
+        push(ANY_NON_DIGITS);
+        break;
+
+      case 'A': // auto date / time
+        if (formatItr + 1 == formatEnd)
+          Rcpp::stop("Invalid format: %%A must be followed by another letter");
+        formatItr++;
+        switch (*formatItr) {
+        case 'D':
+          push(AUTO_DATE);
+          break;
+        case 'T':
+          push(AUTO_TIME);
+          break;
+        default:
+          Rcpp::stop("Invalid %%A auto parser");
+        }
+        break;
+
+      // Compound formats
+      case 'D':
+        compile_compound("%m/%d/%y");
+        break;
+      case 'F':
+        compile_compound("%Y-%m-%d");
+        break;
+      case 'R':
+        compile_compound("%H:%M");
+        break;
+      case 'X':
+      case 'T':
+        compile_compound("%H:%M:%S");
+        break;
+      case 'x':
+        compile_compound("%y/%m/%d");
+        break;
+
+      default:
+        Rcpp::stop("Unsupported format %%%s", *formatItr);
+      }
+    }
+  }
+};
+
 class DateTimeParser {
   int year_, mon_, day_, hour_, min_, sec_;
   double psec_;
@@ -164,6 +387,58 @@ public:
     return isComplete();
   }
 
+  // Fast path for dates which are exactly YYYY-MM-DD. Returns false without
+  // consuming any input if the date does not match, so the general parser can
+  // be used instead.
+  bool parseFixedDate() {
+    if (dateEnd_ - dateItr_ != 10 || !isFixedDate(dateItr_))
+      return false;
+
+    setFixedDate(dateItr_);
+    dateItr_ = dateEnd_;
+    return true;
+  }
+
+  // Fast path for date times which are exactly YYYY-MM-DD HH:MM:SS, with
+  // optional partial seconds. Like parseFixedDate() no input is consumed if
+  // the date time does not match.
+  bool parseFixedDateTime(bool allowT, bool partialSeconds) {
+    const char* p = dateItr_;
+    ptrdiff_t len = dateEnd_ - p;
+    if (len < 19 || !isFixedDate(p) || !isFixedTime(p + 11))
+      return false;
+    if (!(p[10] == ' ' || (allowT && p[10] == 'T')))
+      return false;
+
+    int sec = digits2(p + 17);
+    double psec = 0;
+
+    // Partial seconds are parsed the same way as consumeSeconds(), by
+    // parsing SS.fff as a double and subtracting the whole seconds. To be
+    // exact the digits need to fit in the mantissa.
+    if (len > 19) {
+      if (p[19] != '.' || len == 20 || len > 20 + 13)
+        return false;
+
+      long long value = sec, scale = 1;
+      for (const char* c = p + 20; c != dateEnd_; ++c) {
+        if (*c < '0' || *c > '9')
+          return false;
+        value = value * 10 + (*c - '0');
+        scale *= 10;
+      }
+      psec = static_cast<double>(value) / scale - sec;
+    }
+
+    setFixedDate(p);
+    hour_ = digits2(p + 11);
+    min_ = digits2(p + 14);
+    sec_ = sec;
+    psec_ = partialSeconds ? psec : 0;
+    dateItr_ = dateEnd_;
+    return true;
+  }
+
   bool isComplete() { return dateItr_ == dateEnd_; }
 
   void setDate(const char* start, const char* end) {
@@ -173,66 +448,81 @@ public:
   }
 
   bool parse(const std::string& format) {
-    consumeWhiteSpace(); // always consume leading whitespace
+    return parse(DateTimeFormat(format));
+  }
 
-    std::string::const_iterator formatItr, formatEnd = format.end();
-    for (formatItr = format.begin(); formatItr != formatEnd; ++formatItr) {
-      // Whitespace in format matches 0 or more whitespace in date
-      if (std::isspace(*formatItr)) {
-        consumeWhiteSpace();
-        continue;
-      }
+  bool parse(const DateTimeFormat& format) {
+    if (format.isISO8601()) {
+      return parseFixedDate() || parseFixedDateTime(true, true) ||
+             parseISO8601();
+    }
 
-      // Any other characters must much exactly.
-      if (*formatItr != '%') {
-        if (!consumeThisChar(*formatItr))
-          return false;
-        continue;
-      }
+    switch (format.layout()) {
+    case DateTimeFormat::FIXED_DATE:
+      if (parseFixedDate())
+        return true;
+      break;
+    case DateTimeFormat::FIXED_DATETIME:
+      if (parseFixedDateTime(false, false))
+        return true;
+      break;
+    case DateTimeFormat::FIXED_DATETIME_PARTIAL:
+      if (parseFixedDateTime(false, true))
+        return true;
+      break;
+    case DateTimeFormat::VARIABLE_LAYOUT:
+      break;
+    }
 
-      if (formatItr + 1 == formatEnd)
-        Rcpp::stop("Invalid format: trailing %");
-      formatItr++;
+    consumeWhiteSpace(); // always consume leading whitespace
 
-      switch (*formatItr) {
-      case 'Y': // year with century
+    for (const auto& op : format.ops()) {
+      switch (op.type) {
+      case DateTimeFormat::WHITESPACE:
+        consumeWhiteSpace();
+        break;
+      case DateTimeFormat::LITERAL:
+        if (!consumeThisChar(op.value))
+          return false;
+        break;
+      case DateTimeFormat::YEAR:
         if (!consumeInteger(4, &year_))
           return false;
         break;
-      case 'y': // year without century
+      case DateTimeFormat::YEAR_SHORT:
         if (!consumeInteger(2, &year_))
           return false;
         year_ += (year_ < 69) ? 2000 : 1900;
         break;
-      case 'm': // month
+      case DateTimeFormat::MONTH:
         if (!consumeInteger1(2, &mon_, false))
           return false;
         break;
-      case 'b': // abbreviated month name
+      case DateTimeFormat::MONTH_ABBREV:
         if (!consumeString(pLocale_->monAb_, &mon_))
           return false;
         break;
-      case 'B': // month name
+      case DateTimeFormat::MONTH_NAME:
         if (!consumeString(pLocale_->mon_, &mon_))
           return false;
         break;
-      case 'd': // day
+      case DateTimeFormat::DAY:
         if (!consumeInteger1(2, &day_, false))
           return false;
         break;
-      case 'a': // abbreviated day of week
+      case DateTimeFormat::DAY_ABBREV:
         if (!consumeString(pLocale_->dayAb_, &day_))
           return false;
         break;
-      case 'e': // day with optional leading space
+      case DateTimeFormat::DAY_SPACE:
         if (!consumeInteger1WithSpace(2, &day_))
           return false;
         break;
-      case 'H': // hour
+      case DateTimeFormat::HOUR:
         if (!consumeInteger(2, &hour_, false))
           return false;
         break;
-      case 'I': // hour
+      case DateTimeFormat::HOUR12:
         if (!consumeInteger(2, &hour_, false))
           return false;
         if (hour_ < 1 || hour_ > 12) {
@@ -240,90 +530,50 @@ public:
         }
         hour_ %= 12;
         break;
-      case 'M': // minute
+      case DateTimeFormat::MINUTE:
         if (!consumeInteger(2, &min_))
           return false;
         break;
-      case 'S': // seconds (integer)
+      case DateTimeFormat::SECONDS:
         if (!consumeSeconds(&sec_, NULL))
           return false;
         break;
-      case 'O': // seconds (double)
-        if (formatItr + 1 == formatEnd || *(formatItr + 1) != 'S')
-          Rcpp::stop("Invalid format: %%O must be followed by %%S");
-        formatItr++;
+      case DateTimeFormat::PARTIAL_SECONDS:
         if (!consumeSeconds(&sec_, &psec_))
           return false;
         break;
-
-      case 'p': // AM/PM
+      case DateTimeFormat::AM_PM:
         if (!consumeString(pLocale_->amPm_, &amPm_))
           return false;
         break;
-
-      case 'z': // time zone specification
+      case DateTimeFormat::TZ_OFFSET:
         tz_ = "UTC";
         if (!consumeTzOffset(&tzOffsetHours_, &tzOffsetMinutes_))
           return false;
         break;
-      case 'Z': // time zone name
+      case DateTimeFormat::TZ_NAME:
         if (!consumeTzName(&tz_))
           return false;
         break;
-
-      // Extensions
-      case '.':
+      case DateTimeFormat::NON_DIGIT:
         if (!consumeNonDigit())
           return false;
         break;
-
-      case '+':
+      case DateTimeFormat::NON_DIGITS:
         if (!consumeNonDigits())
           return false;
         break;
-
-      case '*':
+      case DateTimeFormat::ANY_NON_DIGITS:
         consumeNonDigits();
         break;
-
-      case 'A': // auto date / time
-        if (formatItr + 1 == formatEnd)
-          Rcpp::stop("Invalid format: %%A must be followed by another letter");
-        formatItr++;
-        switch (*formatItr) {
-        case 'D':
-          if (!parseDate())
-            return false;
-          break;
-        case 'T':
-          if (!parseTime())
-            return false;
-          break;
-        default:
-          Rcpp::stop("Invalid %%A auto parser");
-        }
-        break;
-
-      // Compound formats
-      case 'D':
-        parse("%m/%d/%y");
-        break;
-      case 'F':
-        parse("%Y-%m-%d");
-        break;
-      case 'R':
-        parse("%H:%M");
-        break;
-      case 'X':
-      case 'T':
-        parse("%H:%M:%S");
+      case DateTimeFormat::AUTO_DATE:
+        if (!parseDate())
+          return false;
         break;
-      case 'x':
-        parse("%y/%m/%d");
+      case DateTimeFormat::AUTO_TIME:
+        if (!parseTime())
+          return false;
         break;
-
-      default:
-        Rcpp::stop("Unsupported format %%%s", *formatItr);
       }
     }
 
@@ -336,6 +586,8 @@ public:
     DateTime dt(year_, mon_, day_, hour(), min_, sec_, psec_, tz_);
     if (tz_ == "UTC")
       dt.setOffset(-tzOffsetHours_ * 3600 - tzOffsetMinutes_ * 60);
+    else if (tz_ == pLocale_->timezone_.name())
+      dt.setTimezone(&pLocale_->timezone_);
 
     return dt;
   }
@@ -374,6 +626,55 @@ private:
     return hour_;
   }
 
+  static inline uint64_t load8(const char* p) {
+    uint64_t out;
+    std::memcpy(&out, p, sizeof(out));
+    return out;
+  }
+
+  // Checks 8 characters against a pattern of digits and separators in a
+  // couple of word sized operations. `mask` keeps the high nibble of digits
+  // and all of separators, `pattern` is '0' for digits and the separator
+  // otherwise. Adding `six` (6 for digits, 0 otherwise) carries any
+  // characters in 0x3A-0x3F out of the 0x30 nibble. The constants are built
+  // from byte arrays so this does not depend on the platform byte order.
+  static inline bool matches8(
+      const char* p, const char* mask, const char* pattern, const char* six) {
+    uint64_t v = load8(p);
+    uint64_t m = load8(mask);
+    uint64_t e = load8(pattern);
+    return (v & m) == e && ((v + load8(six)) & m) == e;
+  }
+
+  // YYYY-MM-DD
+  static inline bool isFixedDate(const char* p) {
+    static const char mask[] = "\xF0\xF0\xF0\xF0\xFF\xF0\xF0\xFF";
+    static const char pattern[] = "0000-00-";
+    static const char six[] = "\x06\x06\x06\x06\x00\x06\x06\x00";
+    return matches8(p, mask, pattern, six) && isDigit(p[8]) && isDigit(p[9]);
+  }
+
+  // HH:MM:SS
+  static inline bool isFixedTime(const char* p) {
+    static const char mask[] = "\xF0\xF0\xFF\xF0\xF0\xFF\xF0\xF0";
+    static const char pattern[] = "00:00:00";
+    static const char six[] = "\x06\x06\x00\x06\x06\x00\x06\x06";
+    return matches8(p, mask, pattern, six);
+  }
+
+  static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+  static inline int digits2(const char* p) {
+    return (p[0] - '0') * 10 + (p[1] - '0');
+  }
+
+  inline void setFixedDate(const char* p) {
+    year_ = digits2(p) * 100 + digits2(p + 2);
+    mon_ = digits2(p + 5) - 1;
+    day_ = digits2(p + 8) - 1;
+    compactDate_ = false;
+  }
+
   inline bool consumeSeconds(int* pSec, double* pPartialSec) {
     double sec;
     if (!consumeDouble(&sec))
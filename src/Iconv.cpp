@@ -4,7 +4,7 @@ using namespace Rcpp;
 #include "Iconv.h"
 
 Iconv::Iconv(const std::string& from, const std::string& to) {
-  if (from == "UTF-8") {
+  if (from == to) {
     cd_ = NULL;
   } else {
     cd_ = Riconv_open(to.c_str(), from.c_str());
@@ -5,7 +5,10 @@
 using namespace Rcpp;
 
 LocaleInfo::LocaleInfo(List x)
-    : encoding_(as<std::string>(x["encoding"])), encoder_(Iconv(encoding_)) {
+    : tz_(as<std::string>(x["tz"])),
+      timezone_(tz_),
+      encoding_(as<std::string>(x["encoding"])),
+      encoder_(Iconv(encoding_)) {
   std::string klass = x.attr("class");
   if (klass != "locale")
     stop("Invalid input: must be of class locale");
@@ -22,6 +25,4 @@ LocaleInfo::LocaleInfo(List x)
 
   dateFormat_ = as<std::string>(x["date_format"]);
   timeFormat_ = as<std::string>(x["time_format"]);
-
-  tz_ = as<std::string>(x["tz"]);
 }
@@ -2,6 +2,7 @@
 #define FASTREAD_LOCALINFO
 
 #include "Iconv.h"
+#include "Timezone.h"
 
 class LocaleInfo {
 
@@ -15,6 +16,7 @@ public:
 
   // LC_MISC
   std::string tz_;
+  Timezone timezone_;
   std::string encoding_;
   Iconv encoder_;
 
@@ -0,0 +1,136 @@
+#ifndef VROOM_TIMEZONE_H_
+#define VROOM_TIMEZONE_H_
+
+#include <ctime>
+
+#include "localtime.h"
+#include <array>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// my_mktime() loads the requested time zone into global state, so calls to it
+// from multiple threads need to be serialized.
+inline std::mutex& mktime_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+inline time_t locked_mktime(stm* const tmp, const char* name) {
+  std::lock_guard<std::mutex> guard(mktime_mutex());
+  return my_mktime(tmp, name);
+}
+
+// Converts local times in a single time zone to UTC without touching the
+// global time zone state for every value.
+//
+// The UTC offset of each day in a year is computed the first time a date in
+// that year is seen. Days containing a transition (e.g. the start or end of
+// daylight saving time) are not cached and fall back to my_mktime(), as do
+// years outside of the cached range. Lookups of already computed years are
+// lock free, so one Timezone can be shared by all threads parsing a column.
+class Timezone {
+  enum { min_year_ = 1800, max_year_ = 2200, transition_ = INT_MIN };
+
+  typedef std::array<int, 366> year_offsets;
+
+  std::string name_;
+  mutable std::array<std::atomic<const year_offsets*>, max_year_ - min_year_>
+      years_;
+  mutable std::vector<std::unique_ptr<year_offsets> > owned_;
+  mutable std::mutex mutex_;
+
+public:
+  Timezone(const std::string& name) : name_(name) {
+    for (auto& year : years_) {
+      year.store(nullptr);
+    }
+  }
+
+  const std::string& name() const { return name_; }
+
+  // Retrieve the offset (in seconds) of local time from UTC for the given
+  // year and (0 based) day of the year. Returns false if the offset is not
+  // constant over the day, in which case my_mktime() needs to be used.
+  bool utcOffset(int year, int yday, int* pOffset) const {
+    if (year < min_year_ || year >= max_year_) {
+      return false;
+    }
+
+    const year_offsets* offsets =
+        years_[year - min_year_].load(std::memory_order_acquire);
+    if (offsets == nullptr) {
+      offsets = loadYear(year);
+    }
+
+    int offset = (*offsets)[yday];
+    if (offset == transition_) {
+      return false;
+    }
+    *pOffset = offset;
+    return true;
+  }
+
+private:
+  const year_offsets* loadYear(int year) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    // Another thread may have computed this year while we were waiting
+    const year_offsets* existing =
+        years_[year - min_year_].load(std::memory_order_acquire);
+    if (existing != nullptr) {
+      return existing;
+    }
+
+    std::unique_ptr<year_offsets> offsets(new year_offsets);
+    offsets->fill(transition_);
+
+    bool leap = (year % 4) == 0 && ((year % 100) != 0 || (year % 400) == 0);
+    int days = 365 + leap;
+    double year_start = daysSinceEpoch(year) * 86400.0;
+
+    {
+      std::lock_guard<std::mutex> mktime_guard(mktime_mutex());
+      for (int yday = 0; yday < days; ++yday) {
+        double day_start = year_start + yday * 86400.0;
+        int start_offset = day_start - mktime(year, yday, 0, 0, 0);
+        int end_offset = (day_start + 86399) - mktime(year, yday, 23, 59, 59);
+
+        if (start_offset == end_offset) {
+          (*offsets)[yday] = start_offset;
+        }
+      }
+    }
+
+    const year_offsets* out = offsets.get();
+    owned_.push_back(std::move(offsets));
+    years_[year - min_year_].store(out, std::memory_order_release);
+
+    return out;
+  }
+
+  // mktime_mutex() must be held when calling this
+  time_t mktime(int year, int yday, int hour, int min, int sec) const {
+    struct Rtm tm;
+    tm.tm_year = year - 1900;
+    tm.tm_mon = 0;
+    tm.tm_mday = yday + 1;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    tm.tm_isdst = -1;
+
+    return my_mktime(&tm, name_.c_str());
+  }
+
+  // Number of days from 1970-01-01 to January 1st of the given (positive) year
+  static long daysSinceEpoch(int year) {
+    long y = year - 1;
+    return 365L * (year - 1970) + (y / 4 - y / 100 + y / 400) - 477;
+  }
+};
+
+#endif
@@ -17,14 +17,16 @@ void vroom_materialize(Rcpp::List x) {
   for (int i = 0; i < x.length(); ++i) {
 
     // First materialize all of the non-character vectors
-    if (TYPEOF(x[i]) == REALSXP || TYPEOF(x[i]) == INTSXP) {
+    if (TYPEOF(x[i]) == REALSXP || TYPEOF(x[i]) == INTSXP ||
+        TYPEOF(x[i]) == LGLSXP) {
       t.emplace_back(std::thread([&, i]() { DATAPTR(x[i]); }));
     }
   }
 
   // Then materialize the rest
   for (int i = 0; i < x.length(); ++i) {
-    if (!(TYPEOF(x[i]) == REALSXP || TYPEOF(x[i]) == INTSXP)) {
+    if (!(TYPEOF(x[i]) == REALSXP || TYPEOF(x[i]) == INTSXP ||
+          TYPEOF(x[i]) == LGLSXP)) {
       DATAPTR(x[i]);
     }
   }
@@ -3,6 +3,7 @@
 #include "parallel.h"
 
 #include <fstream>
+#include <limits>
 
 #ifdef VROOM_LOG
 #include "spdlog/sinks/basic_file_sink.h" // support for basic file logging
@@ -23,7 +24,8 @@ index::index(
     size_t n_max,
     const char comment,
     size_t num_threads,
-    bool progress)
+    bool progress,
+    bool sparse)
     : filename_(filename),
       has_header_(has_header),
       quote_(quote),
@@ -35,7 +37,8 @@ index::index(
       rows_(0),
       columns_(0),
       progress_(progress),
-      delim_len_(0) {
+      delim_len_(0),
+      sparse_(sparse) {
 
   std::error_code error;
   mmap_ = mio::make_mmap_source(filename, error);
@@ -52,8 +55,6 @@ index::index(
 
   size_t start = find_first_line(mmap_);
 
-  std::string delim_;
-
   if (delim == nullptr) {
     delim_ = std::string(1, guess_delim(mmap_, start));
   } else {
@@ -91,6 +92,8 @@ index::index(
   }
 
   idx_ = std::vector<idx_t>(num_threads + 1);
+  flags_ = std::vector<flags_t>(num_threads + 1);
+  ragged_ = std::vector<ragged_region>(num_threads + 1);
 
   bool nmax_set = n_max != static_cast<size_t>(-1);
 
@@ -100,9 +103,12 @@ index::index(
 
   // Index the first row
   idx_[0].push_back(start - 1);
+  flags_[0].push_back(0);
   size_t lines_read = index_region(
       mmap_,
       idx_[0],
+      flags_[0],
+      ragged_[0],
       delim_.c_str(),
       quote,
       start,
@@ -113,42 +119,69 @@ index::index(
       -1);
   columns_ = idx_[0].size() - 1;
 
+  // Indexes expected to be larger than VROOM_INDEX_MEMORY_LIMIT are stored in
+  // temporary files instead of memory. The file names need to come from R,
+  // so are found here rather than by the threads.
+  double index_size = static_cast<double>(guessed_rows) * cells_per_row(1) *
+                      (sizeof(size_t) + sizeof(unsigned char));
+  if (index_size > get_env<double>(
+                       "VROOM_INDEX_MEMORY_LIMIT",
+                       std::numeric_limits<double>::infinity())) {
+    std::string prefix = Rcpp::as<std::string>(Rcpp::as<Rcpp::Function>(
+        Rcpp::Environment::namespace_env("vroom")["vroom_tempfile"])());
+    for (size_t k = 1; k < idx_.size(); ++k) {
+      idx_[k].use_file(prefix + "-idx-" + std::to_string(k));
+      flags_[k].use_file(prefix + "-flags-" + std::to_string(k));
+    }
+  }
+
   std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(num_threads);
 
   if (nmax_set) {
 
     threads.emplace_back([&] {
-      n_max -= lines_read;
-      index_region(
-          mmap_,
-          idx_[1],
-          delim_.c_str(),
-          quote,
-          first_nl,
-          file_size,
-          0,
-          n_max,
-          pb,
-          file_size / 100);
+      catch_indexing_error(errors[0], pb, [&] {
+        n_max -= lines_read;
+        index_region(
+            mmap_,
+            idx_[1],
+            flags_[1],
+            ragged_[1],
+            delim_.c_str(),
+            quote,
+            first_nl,
+            file_size,
+            0,
+            n_max,
+            pb,
+            file_size / 100);
+      });
     });
   } else {
     threads = parallel_for(
         file_size - first_nl,
         [&](size_t start, size_t end, size_t id) {
-          idx_[id + 1].reserve((guessed_rows / num_threads) * columns_);
-          start = find_next_newline(mmap_, first_nl + start);
-          end = find_next_newline(mmap_, first_nl + end);
-          index_region(
-              mmap_,
-              idx_[id + 1],
-              delim_.c_str(),
-              quote,
-              start,
-              end,
-              0,
-              n_max,
-              pb,
-              file_size / 100);
+          catch_indexing_error(errors[id], pb, [&] {
+            start = find_next_newline(mmap_, first_nl + start);
+
+            // Each region includes the newline ending it, which is also the
+            // start of the next region
+            end = find_next_newline(mmap_, first_nl + end) + 1;
+            index_region(
+                mmap_,
+                idx_[id + 1],
+                flags_[id + 1],
+                ragged_[id + 1],
+                delim_.c_str(),
+                quote,
+                start,
+                end,
+                0,
+                n_max,
+                pb,
+                file_size / 100);
+          });
         },
         num_threads,
         true,
@@ -163,13 +196,13 @@ index::index(
     t.join();
   }
 
-  size_t total_size = std::accumulate(
-      idx_.begin(), idx_.end(), 0, [](size_t sum, const idx_t& v) {
-        sum += v.size() - 1;
-        return sum;
-      });
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
 
-  rows_ = columns_ > 0 ? total_size / columns_ : 0;
+  rows_ = count_rows();
 
   if (rows_ > 0 && has_header_) {
     --rows_;
@@ -179,8 +212,8 @@ index::index(
 #if SPDLOG_ACTIVE_LEVEL <= SPD_LOG_LEVEL_DEBUG
   auto log = spdlog::basic_logger_mt("basic_logger", "logs/index.idx", true);
   for (auto& i : idx_) {
-    for (auto& v : i) {
-      SPDLOG_LOGGER_DEBUG(log, "{}", v);
+    for (size_t j = 0; j < i.size(); ++j) {
+      SPDLOG_LOGGER_DEBUG(log, "{}", i[j]);
     }
     SPDLOG_LOGGER_DEBUG(log, "end of idx {0:x}", (size_t)&i);
   }
@@ -214,14 +247,18 @@ void index::trim_whitespace(const char*& begin, const char*& end) const {
 }
 
 const string index::get_escaped_string(
-    const char* begin, const char* end, bool has_quote) const {
+    const char* begin,
+    const char* end,
+    bool has_quote,
+    string_arena& arena) const {
   // If not escaping just return without a copy
   if (!((escape_double_ && has_quote) || escape_backslash_)) {
     return {begin, end};
   }
 
-  std::string out;
-  out.reserve(end - begin);
+  // Unescaping only ever removes characters, so the cell size is enough
+  char* out = arena.allocate(end - begin);
+  char* out_end = out;
 
   while (begin < end) {
     if ((escape_double_ && has_quote && *begin == quote_) ||
@@ -229,78 +266,268 @@ const string index::get_escaped_string(
       ++begin;
     }
 
-    out.push_back(*begin++);
+    *out_end++ = *begin++;
+  }
+
+  return {out, out_end};
+}
+
+void index::resolve_row_end(
+    cell& c, size_t region, size_t i, size_t end_offset) const {
+  if (c.flags & CELL_MISSING) {
+    c.begin = c.end;
+  } else if (c.flags & CELL_TRUNCATED) {
+    const auto& rows = ragged_[region].rows;
+    auto row = std::lower_bound(
+        rows.begin(),
+        rows.end(),
+        i,
+        [](const ragged_region::entry& e, size_t i) { return e.cell < i; });
+    c.end = mmap_.data() + row->end;
+  } else if (c.flags & CELL_SKIPPED_LINES) {
+    // The last cell of a row followed by skipped lines ends at the first
+    // newline
+    c.end = static_cast<const char*>(
+                memchr(c.begin, '\n', c.end + end_offset - c.begin + 1)) -
+            end_offset;
+  }
+  c.flags &= ~CELL_ROW_END;
+}
+
+size_t index::count_rows() const {
+  if (columns_ == 0) {
+    return 0;
+  }
+
+  size_t rows = 0;
+  for (size_t k = 0; k < idx_.size(); ++k) {
+    if (!idx_[k].empty()) {
+      rows += (idx_[k].size() - 1) / cells_per_row(k);
+    }
+  }
+  return rows;
+}
+
+std::vector<ragged_row> index::ragged_rows() const {
+  std::vector<ragged_row> out;
+  if (columns_ == 0) {
+    return out;
+  }
+
+  size_t rows_before = 0;
+  for (size_t k = 0; k < idx_.size(); ++k) {
+    for (const auto& e : ragged_[k].rows) {
+      // The offsets of a region start with the one before its first row
+      size_t row = rows_before + e.cell / cells_per_row(k) - 1;
+      out.push_back({row - has_header_, e.fields});
+    }
+    if (!idx_[k].empty()) {
+      rows_before += (idx_[k].size() - 1) / cells_per_row(k);
+    }
   }
 
   return out;
 }
 
-inline std::pair<const char*, const char*>
-index::get_cell(size_t i, bool is_first) const {
+// Trim whitespace and quotes from the cells and flag those needing to be
+// unescaped. Only the cells flagged when indexing can need any of this, all
+// others are used as they are.
+void index::trim_cells(cell* cells, size_t n) const {
+  for (size_t i = 0; i < n; ++i) {
+    cell& c = cells[i];
+    if (c.flags == 0) {
+      continue;
+    }
+
+    int hints = c.flags;
+    c.flags = 0;
 
-  auto oi = i;
+    if (trim_ws_ && (hints & CELL_SPACE)) {
+      trim_whitespace(c.begin, c.end);
+    }
 
-  for (const auto& idx : idx_) {
-    auto sz = idx.size();
-    if (i + 1 < sz) {
+    if (quote_ != '\0' && (hints & CELL_QUOTED) && c.begin != c.end &&
+        *c.begin == quote_) {
+      c.flags = CELL_QUOTED;
+      trim_quotes(c.begin, c.end);
 
-      // By relying on 0 and 1 being true and false we can remove a branch
-      // here, which improves performance a bit, as this function is called a
-      // lot.
-      return {mmap_.data() + (idx[i] + (!is_first * delim_len_) + is_first),
-              mmap_.data() + idx[i + 1]};
+      if (escape_double_ && (hints & CELL_ESCAPED) &&
+          memchr(c.begin, quote_, c.end - c.begin) != nullptr) {
+        c.flags |= CELL_ESCAPED;
+      }
     }
 
-    i -= (sz - 1);
+    if (escape_backslash_ && (hints & CELL_ESCAPED) &&
+        memchr(c.begin, '\\', c.end - c.begin) != nullptr) {
+      c.flags |= CELL_ESCAPED;
+    }
   }
+}
 
-  std::stringstream ss;
-  ss.imbue(std::locale(""));
-  ss << "Failure to retrieve index " << std::fixed << oi << " / " << rows_;
-  throw std::out_of_range(ss.str());
-  /* should never get here */
-  return {0, 0};
+const string index::get_trimmed_val(size_t i, string_arena& arena) const {
+  cell c;
+  find_cells(i / columns_, i % columns_, 1, &c);
+  return get_string(c, arena);
 }
 
 const string
-index::get_trimmed_val(size_t i, bool is_first, bool is_last) const {
+index::get(size_t row, size_t col, string_arena& arena) const {
+  auto i = (row + has_header_) * columns_ + col;
+
+  return get_trimmed_val(i, arena);
+}
 
-  const char* begin;
-  const char* end;
+void index::find_cells(size_t row, size_t col, size_t n, cell* out) const {
+  bool is_first = col == 0;
+  bool is_last = col == (columns_ - 1);
 
-  std::tie(begin, end) = get_cell(i, is_first);
+  // The first cell of a row starts after the newline, the others after the
+  // delimiter
+  size_t begin_offset = is_first ? 1 : delim_len_;
+  size_t end_offset = is_last && windows_newlines_;
 
-  if (is_last && windows_newlines_) {
-    end--;
+  // The characters find_field() stops at, as in index_region_kernel()
+  std::array<char, 5> query = {delim_[0], '\n', '\0', '\0', '\0'};
+  size_t query_size = 2;
+  if (quote_ != '\0') {
+    query[query_size++] = quote_;
+  }
+  if (escape_backslash_) {
+    query[query_size++] = '\\';
   }
 
-  if (trim_ws_) {
-    trim_whitespace(begin, end);
+  const char* data = mmap_.data();
+  auto r = row;
+  size_t filled = 0;
+
+  for (size_t k = 0; k < idx_.size() && filled < n; ++k) {
+    const auto& idx = idx_[k];
+    const auto& flags = flags_[k];
+    size_t region_rows =
+        idx.empty() ? 0 : (idx.size() - 1) / cells_per_row(k);
+
+    if (is_sparse(k)) {
+      // Scan from the end of the nearest kept cell before the field, or the
+      // start of the row. If that cell ends the row the field is missing.
+      size_t per_row = cells_per_row(k);
+      size_t kept = col / sparse_fields;
+      size_t field = kept * sparse_fields;
+      size_t skip = kept == 0 ? 1 : delim_len_;
+      auto i = r * per_row + kept;
+      for (; filled < n && r < region_rows; ++filled, ++r, i += per_row) {
+        const char* p = data + idx[i];
+        if (kept > 0 && *p == '\n') {
+          out[filled] = {p, p, 0};
+        } else {
+          out[filled] =
+              find_field(p + skip, field, col, end_offset, query.data());
+        }
+      }
+    } else {
+      auto i = r * columns_ + col;
+      for (; filled < n && r < region_rows; ++filled, ++r, i += columns_) {
+        out[filled].begin = data + idx[i] + begin_offset;
+        out[filled].end = data + idx[i + 1] - end_offset;
+        out[filled].flags = flags[i + 1];
+        if (out[filled].flags & CELL_ROW_END) {
+          resolve_row_end(out[filled], k, i + 1, end_offset);
+        }
+      }
+    }
+
+    r -= region_rows;
   }
 
-  bool has_quote = false;
-  if (quote_ != '\0') {
-    has_quote = *begin == quote_;
-    if (has_quote) {
-      trim_quotes(begin, end);
+  if (filled < n) {
+    std::stringstream ss;
+    ss.imbue(std::locale(""));
+    ss << "Failure to retrieve row " << std::fixed
+       << row - has_header_ + filled << " / " << num_rows();
+    throw std::out_of_range(ss.str());
+  }
+
+  trim_cells(out, n);
+}
+
+cell index::find_field(
+    const char* begin,
+    size_t field,
+    size_t col,
+    size_t end_offset,
+    const char* query) const {
+  const char* p = begin;
+  bool in_quote = false;
+  size_t num_quotes = 0;
+  int flags = 0;
+
+  while (true) {
+    p += strcspn(p, query);
+    char c = *p;
+
+    bool is_delim =
+        !in_quote && c == delim_[0] && c != '\n' &&
+        (delim_len_ == 1 || strncmp(delim_.data(), p, delim_len_) == 0);
+
+    if (is_delim || c == '\n') {
+      if (field == col) {
+        break;
+      }
+
+      // A row with too few fields is padded with empty cells
+      if (c == '\n') {
+        return {p, p, 0};
+      }
+
+      ++field;
+      begin = p + delim_len_;
+      num_quotes = 0;
+      flags = 0;
+    } else if (quote_ != '\0' && c == quote_) {
+      in_quote = !in_quote;
+      ++num_quotes;
+    } else if (escape_backslash_ && c == '\\') {
+      flags |= CELL_ESCAPED;
+      ++p;
     }
+
+    ++p;
   }
 
-  return get_escaped_string(begin, end, has_quote);
-}
+  const char* end = p;
+  if (*p == '\n') {
+    // Only the last column includes any windows newline in its offset, other
+    // cells ending a short row exclude it when indexing
+    if (col == columns_ - 1) {
+      end -= end_offset;
+    } else if (windows_newlines_ && end > begin && *(end - 1) == '\r') {
+      --end;
+    }
+  }
 
-const string index::get(size_t row, size_t col) const {
-  auto i = (row + has_header_) * columns_ + col;
+  if (num_quotes > 0) {
+    flags |= CELL_QUOTED;
+  }
+  if (num_quotes > 2 && escape_double_) {
+    flags |= CELL_ESCAPED;
+  }
+  if (trim_ws_) {
+    flags |= CELL_SPACE;
+  }
 
-  return get_trimmed_val(i, col == 0, col == (columns_ - 1));
+  return {begin, end, flags};
 }
 
 index::column::iterator::iterator(
-    const index& idx, size_t column, size_t start, size_t end)
-    : idx_(&idx), column_(column), start_(start + idx_->has_header_) {
+    const index& idx,
+    size_t column,
+    size_t start,
+    size_t end,
+    string_arena& arena)
+    : idx_(&idx),
+      column_(column),
+      start_(start + idx_->has_header_),
+      arena_(&arena) {
   i_ = (start_ * idx_->columns_) + column_;
-  is_first_ = column == 0;
-  is_last_ = column == (idx_->columns_ - 1);
 }
 
 index::column::iterator index::column::iterator::operator++(int) /* postfix */ {
@@ -333,7 +560,8 @@ operator==(const index::column::iterator& other) const {
 }
 
 string index::column::iterator::operator*() const {
-  return idx_->get_trimmed_val(i_, is_first_, is_last_);
+  arena_->reset();
+  return idx_->get_trimmed_val(i_, *arena_);
 }
 
 index::column::iterator& index::column::iterator::operator+=(int n) {
@@ -368,16 +596,20 @@ index::column::column(const index& idx, size_t column)
     : idx_(idx), column_(column) {}
 
 index::column::iterator index::column::begin() {
-  return index::column::iterator(idx_, column_, 0, idx_.num_rows());
+  return index::column::iterator(idx_, column_, 0, idx_.num_rows(), arena_);
 }
 index::column::iterator index::column::end() {
   return index::column::iterator(
-      idx_, column_, idx_.num_rows(), idx_.num_rows());
+      idx_, column_, idx_.num_rows(), idx_.num_rows(), arena_);
 }
 
 index::row::iterator::iterator(
-    const index& idx, size_t row, size_t start, size_t end)
-    : idx_(&idx), row_(row), start_(start) {
+    const index& idx,
+    size_t row,
+    size_t start,
+    size_t end,
+    string_arena& arena)
+    : idx_(&idx), row_(row), start_(start), arena_(&arena) {
 
   i_ = (row_ + idx_->has_header_) * idx_->columns_ + start_;
 }
@@ -400,7 +632,8 @@ bool index::row::iterator::operator==(const index::row::iterator& other) const {
 }
 
 string index::row::iterator::operator*() {
-  return idx_->get_trimmed_val(i_, i_ == 0, i_ == (idx_->columns_ - 1));
+  arena_->reset();
+  return idx_->get_trimmed_val(i_, *arena_);
 }
 
 index::row::iterator& index::row::iterator::operator+=(int n) {
@@ -418,9 +651,9 @@ index::row::iterator index::row::iterator::operator+(int n) {
 index::row::row(const index& idx, size_t row) : idx_(idx), row_(row) {}
 
 index::row::iterator index::row::begin() {
-  return index::row::iterator(idx_, row_, 0, idx_.num_rows());
+  return index::row::iterator(idx_, row_, 0, idx_.num_rows(), arena_);
 }
 index::row::iterator index::row::end() {
   return index::row::iterator(
-      idx_, row_, idx_.num_columns(), idx_.num_columns());
+      idx_, row_, idx_.num_columns(), idx_.num_columns(), arena_);
 }
@@ -9,7 +9,13 @@
 // clang-format on
 
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
 
+#include "index_vector.h"
 #include "multi_progress.h"
 
 #include <Rcpp.h>
@@ -23,19 +29,62 @@
 
 namespace vroom {
 
+// The flags of a cell. While indexing these are recorded for each cell as
+// hints of what it might contain, and a cell with no flags set is used as is.
+// After get_cells() they describe exactly what was found.
+enum cell_flags {
+  // The cell was quoted, the quotes are not included in the cell
+  CELL_QUOTED = 1,
+
+  // The cell contains escapes, so needs to be unescaped by index::get_string()
+  CELL_ESCAPED = 2,
+
+  // The cell has leading or trailing whitespace, only recorded when indexing
+  // and if whitespace is trimmed
+  CELL_SPACE = 4,
+
+  CELL_ALL = CELL_QUOTED | CELL_ESCAPED | CELL_SPACE,
+
+  // Only recorded when indexing, the cell is the last of a row followed by
+  // skipped comment or blank lines. Its offset is the end of the skipped
+  // lines, so the next row starts in the right place, and the cell itself
+  // ends at the first newline after its start.
+  CELL_SKIPPED_LINES = 8,
+
+  // Only recorded when indexing, the cell pads a row with too few fields so
+  // it is empty. Its offset is the end of the row.
+  CELL_MISSING = 16,
+
+  // Only recorded when indexing, the cell is the last kept of a row with too
+  // many fields. Its offset is the end of the row, and the cell itself ends
+  // where recorded in the ragged_region of the index.
+  CELL_TRUNCATED = 32,
+
+  // The flags describing where a cell ends rather than what it contains
+  CELL_ROW_END = CELL_SKIPPED_LINES | CELL_MISSING | CELL_TRUNCATED
+};
+
+// The bytes of a cell after trimming, as returned by index::get_cells()
 struct cell {
   const char* begin;
   const char* end;
+  int flags;
 };
 
-// A custom string wrapper that avoids constructing a string object unless
-// needed because of escapes.
+// A row with a different number of fields than the file has columns
+struct ragged_row {
+  // The row, 0 based and after any header
+  size_t row;
+
+  // The number of fields found
+  size_t fields;
+};
+
+// A view of a string, usually directly into the file. The contents of cells
+// with escapes are copied (unescaped) into a string_arena, so such strings are
+// only valid until the arena is reset.
 class string {
 public:
-  string(std::string str) : str_(str) {
-    begin_ = str_.c_str();
-    end_ = begin_ + str_.length();
-  }
   string(const char* begin, const char* end) : begin_(begin), end_(end) {}
 
   const char* begin() const { return begin_; }
@@ -59,9 +108,86 @@ public:
 private:
   const char* begin_;
   const char* end_;
-  std::string str_;
 };
 
+// A bump allocator for the unescaped contents of cells. Memory is allocated
+// in blocks which are kept when the arena is reset, so reading escaped cells
+// does not allocate once the arena has grown large enough. An arena is not
+// thread safe, so each thread needs its own. Copies of an arena start empty.
+class string_arena {
+  static const size_t block_size = 1 << 16;
+
+  std::vector<std::unique_ptr<char[]> > blocks_;
+
+  // Strings too long for a block each get their own allocation
+  std::vector<std::unique_ptr<char[]> > large_;
+
+  // The number of blocks in use, and the bytes used in the last of them
+  size_t num_used_;
+  size_t used_;
+
+public:
+  string_arena() : num_used_(0), used_(0) {}
+  string_arena(const string_arena&) : string_arena() {}
+  string_arena& operator=(const string_arena&) { return *this; }
+
+  char* allocate(size_t size) {
+    if (size > block_size) {
+      large_.emplace_back(new char[size]);
+      return large_.back().get();
+    }
+
+    if (num_used_ == 0 || used_ + size > block_size) {
+      if (num_used_ == blocks_.size()) {
+        blocks_.emplace_back(new char[block_size]);
+      }
+      ++num_used_;
+      used_ = 0;
+    }
+
+    char* out = blocks_[num_used_ - 1].get() + used_;
+    used_ += size;
+    return out;
+  }
+
+  // Make all the memory available again, invalidating all strings using it
+  void reset() {
+    num_used_ = 0;
+    used_ = 0;
+    large_.clear();
+  }
+};
+
+// A fast non-cryptographic hash in the style of wyhash / xxh3. The input is
+// consumed 8 bytes at a time and mixed with 64 bit multiplies, then finalized
+// with the murmur3 avalanche so the low bits are usable as a table index.
+inline uint64_t hash_bytes(const char* begin, const char* end) {
+  const uint64_t m1 = 0x9E3779B97F4A7C15ULL;
+  const uint64_t m2 = 0xBF58476D1CE4E5B9ULL;
+
+  uint64_t h = (end - begin) * m1;
+  uint64_t k;
+  while (end - begin >= 8) {
+    std::memcpy(&k, begin, 8);
+    h ^= k * m2;
+    h = ((h << 31) | (h >> 33)) * m1;
+    begin += 8;
+  }
+  if (begin != end) {
+    k = 0;
+    std::memcpy(&k, begin, end - begin);
+    h ^= k * m2;
+    h = ((h << 31) | (h >> 33)) * m1;
+  }
+
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
 class index {
 
 public:
@@ -77,11 +203,15 @@ public:
       size_t n_max,
       const char comment,
       const size_t num_threads,
-      const bool progress);
+      const bool progress,
+      const bool sparse);
 
+  // Values read from a column or row are valid until the next value is read
+  // from it
   class column {
     const index& idx_;
     size_t column_;
+    string_arena arena_;
 
   public:
     column(const index& idx, size_t column);
@@ -91,8 +221,7 @@ public:
       const index* idx_;
       size_t column_;
       size_t start_;
-      bool is_first_;
-      bool is_last_;
+      string_arena* arena_;
 
     public:
       using iterator_category = std::forward_iterator_tag;
@@ -101,7 +230,12 @@ public:
       using reference = string&;
       using difference_type = ptrdiff_t;
 
-      iterator(const index& idx, size_t column, size_t start, size_t end);
+      iterator(
+          const index& idx,
+          size_t column,
+          size_t start,
+          size_t end,
+          string_arena& arena);
       iterator operator++(int); /* postfix */
       iterator& operator++();   /* prefix */
       iterator operator--(int); /* postfix */
@@ -123,6 +257,7 @@ public:
   class row {
     const index& idx_;
     size_t row_;
+    string_arena arena_;
 
   public:
     row(const index& idx, size_t row);
@@ -132,6 +267,7 @@ public:
       const index* idx_;
       size_t row_;
       size_t start_;
+      string_arena* arena_;
 
     public:
       using iterator_category = std::forward_iterator_tag;
@@ -139,7 +275,12 @@ public:
       using pointer = string*;
       using reference = string&;
 
-      iterator(const index& idx, size_t row, size_t start, size_t end);
+      iterator(
+          const index& idx,
+          size_t row,
+          size_t start,
+          size_t end,
+          string_arena& arena);
       iterator operator++(int); /* postfix */
       iterator& operator++();   /* prefix */
       bool operator!=(const iterator& other) const;
@@ -153,14 +294,37 @@ public:
     iterator end();
   };
 
-  index() : rows_(0), columns_(0){};
+  index() : rows_(0), columns_(0), sparse_(false){};
+
+  // Virtual so index_connection removes its temporary file when deleted
+  // through an index pointer
+  virtual ~index() {}
 
-  const string get(size_t row, size_t col) const;
+  // Escaped values are stored in `arena`
+  const string get(size_t row, size_t col, string_arena& arena) const;
+
+  // Find the cells of `n` rows of column `col`, starting at `row`. This gives
+  // the same values as get() for each cell, but the index is searched once
+  // for the whole batch, and only cells flagged when indexing are trimmed.
+  void get_cells(size_t row, size_t col, size_t n, cell* out) const {
+    find_cells(row + has_header_, col, n, out);
+  }
+
+  // The value of a cell from get_cells(), unescaped into `arena` if needed
+  const string get_string(const cell& c, string_arena& arena) const {
+    if (c.flags & CELL_ESCAPED) {
+      return get_escaped_string(c.begin, c.end, c.flags & CELL_QUOTED, arena);
+    }
+    return {c.begin, c.end};
+  }
 
   size_t num_columns() const { return columns_; }
 
   size_t num_rows() const { return rows_; }
 
+  // The rows which were padded or truncated to the number of columns
+  std::vector<ragged_row> ragged_rows() const;
+
   std::string filename() const { return filename_; }
 
   column get_column(size_t col) const {
@@ -172,10 +336,86 @@ public:
   row get_header() const { return vroom::index::row(*this, -1); }
 
 public:
-  using idx_t = std::vector<size_t>;
+  using idx_t = index_vector<size_t>;
+  using flags_t = index_vector<unsigned char>;
   std::string filename_;
   mio::mmap_source mmap_;
   std::vector<idx_t> idx_;
+
+  // The cell_flags of the cell ending at each offset in idx_
+  std::vector<flags_t> flags_;
+
+  // Where skip_lines() stopped when it reached the end of a buffer
+  enum skip_state {
+    // In a line of data
+    SKIP_NONE,
+
+    // At the start of a line, after any whitespace
+    SKIP_LINE_START,
+
+    // In a comment or blank line
+    SKIP_IN_LINE
+  };
+
+  // The rows of a region of the index with the wrong number of fields
+  struct ragged_region {
+    struct entry {
+      // The position in idx_ of the offset ending the row
+      size_t cell;
+      size_t fields;
+
+      // For truncated rows the offset the last kept cell actually ends at
+      size_t end;
+    };
+    std::vector<entry> rows;
+
+    // The number of fields so far in the row being indexed, so a row can be
+    // continued by the next call to index_region()
+    size_t fields = 0;
+
+    // Where the last call to index_region() stopped in any lines being
+    // skipped
+    skip_state skip = SKIP_NONE;
+  };
+
+  // The ragged rows of each region in idx_
+  std::vector<ragged_region> ragged_;
+
+  bool is_sparse(size_t region) const { return sparse_ && region > 0; }
+
+  // In sparse regions the end of every sparse_fields'th cell of a row is kept
+  // along with the end of the row, so finding a field never needs to scan
+  // more than this many fields
+  static const size_t sparse_fields = 16;
+
+  size_t sparse_cells_per_row() const {
+    return (columns_ + sparse_fields - 1) / sparse_fields;
+  }
+
+  size_t cells_per_row(size_t region) const {
+    return is_sparse(region) ? sparse_cells_per_row() : columns_;
+  }
+
+  // The number of complete rows in idx_, including any header
+  size_t count_rows() const;
+
+  // Run `f` on an indexing thread, keeping any error in `error` to be
+  // rethrown once the threads are joined, as exceptions cannot leave a
+  // thread. On an error the progress bar `pb` is finished, so nothing waits
+  // for it.
+  template <typename P, typename F>
+  static void
+  catch_indexing_error(std::exception_ptr& error, const P& pb, F f) {
+    try {
+      f();
+    } catch (...) {
+      error = std::current_exception();
+      if (pb) {
+        pb->finish();
+      }
+    }
+  }
+
   bool has_header_;
   char quote_;
   bool trim_ws_;
@@ -187,7 +427,13 @@ public:
   size_t rows_;
   size_t columns_;
   bool progress_;
+  std::string delim_;
   size_t delim_len_;
+
+  // Whether only the end of each row and of every sparse_fields'th cell is
+  // stored in idx_, rather than the end of every cell. This is only done
+  // after the first row, so idx_[0] always has every cell.
+  bool sparse_;
   std::locale loc_;
 
   void skip_lines();
@@ -208,6 +454,49 @@ public:
     return false;
   }
 
+  // Skip any comment or blank lines starting at `pos`, which is the start of a
+  // line or where the last call stopped, returning the start of the next line
+  // of data. If `end` is reached first, `state` records where, so the next
+  // call can carry on in the next buffer of a connection. Blank lines are data
+  // in files with one column, so are only skipped if there are several.
+  size_t
+  skip_lines(const char* buf, size_t pos, size_t end, skip_state& state) const {
+    bool skip_blank = columns_ > 1;
+    if (comment_ == '\0' && !skip_blank) {
+      state = SKIP_NONE;
+      return pos;
+    }
+
+    size_t line_start = pos;
+    while (pos < end) {
+      if (state == SKIP_IN_LINE) {
+        auto nl =
+            static_cast<const char*>(memchr(buf + pos, '\n', end - pos));
+        if (nl == nullptr) {
+          return end;
+        }
+        pos = line_start = nl - buf + 1;
+        state = SKIP_LINE_START;
+        continue;
+      }
+
+      // A delimiter is never whitespace here, so a row of empty fields is
+      // not taken for a blank line
+      char c = buf[pos];
+      if ((c == ' ' || c == '\t' || c == '\r') && c != delim_[0]) {
+        ++pos;
+      } else if (
+          (comment_ != '\0' && c == comment_) || (skip_blank && c == '\n')) {
+        state = SKIP_IN_LINE;
+      } else {
+        state = SKIP_NONE;
+        return line_start;
+      }
+    }
+
+    return state == SKIP_IN_LINE ? end : line_start;
+  }
+
   template <typename T> size_t skip_bom(const T& source) {
     /* Skip Unicode Byte Order Marks
        https://en.wikipedia.org/wiki/Byte_order_mark#Representations_of_byte_order_marks_by_encoding
@@ -282,16 +571,40 @@ public:
 
   void trim_quotes(const char*& begin, const char*& end) const;
   void trim_whitespace(const char*& begin, const char*& end) const;
-  const string
-  get_escaped_string(const char* begin, const char* end, bool has_quote) const;
-
-  const string get_trimmed_val(size_t i, bool is_first, bool is_last) const;
-
-  std::pair<const char*, const char*> get_cell(size_t i, bool is_first) const;
+  const string get_escaped_string(
+      const char* begin,
+      const char* end,
+      bool has_quote,
+      string_arena& arena) const;
+
+  // The value of the `i`th cell, counting any header
+  const string get_trimmed_val(size_t i, string_arena& arena) const;
+
+  void trim_cells(cell* cells, size_t n) const;
+
+  // As get_cells(), but with `row` counting any header
+  void find_cells(size_t row, size_t col, size_t n, cell* out) const;
+
+  // Scan from `begin`, the start of field `field` of a row, for field `col`,
+  // for sparse regions. `query` has the characters to stop at, as when
+  // indexing.
+  cell find_field(
+      const char* begin,
+      size_t field,
+      size_t col,
+      size_t end_offset,
+      const char* query) const;
+
+  // Find the end of a cell with any of CELL_ROW_END set, `i` being the
+  // position in idx_[region] of its offset
+  void
+  resolve_row_end(cell& c, size_t region, size_t i, size_t end_offset) const;
 
   /*
    * @param source the source to index
    * @param destination the index to push to
+   * @param flags the flags of each cell to push to
+   * @param ragged the rows with the wrong number of fields to push to
    * @param delim the delimiter to use
    * @param quote the quoting character
    * @param start the start of the region to index
@@ -305,6 +618,8 @@ public:
   size_t index_region(
       const T& source,
       idx_t& destination,
+      flags_t& flags,
+      ragged_region& ragged,
       const char* delim,
       const char quote,
       const size_t start,
@@ -314,34 +629,321 @@ public:
       P& pb,
       const size_t update_size = -1) {
 
-    // If there are no quotes quote will be '\0', so will just work
-    std::array<char, 5> query = {delim[0], '\n', '\\', quote, '\0'};
+    // A kernel specialized for each combination of the options which change
+    // how bytes are scanned, so none of them are checked in the inner loop.
+    // Indexed by multi-character delimiter, quotes, backslash escapes and
+    // whitespace trimming, in that order.
+    using kernel = size_t (index::*)(
+        const T&,
+        idx_t&,
+        flags_t&,
+        ragged_region&,
+        const char*,
+        const char,
+        const size_t,
+        const size_t,
+        const size_t,
+        const size_t,
+        P&,
+        const size_t);
+    static const kernel kernels[] = {
+        &index::index_region_kernel<T, P, false, false, false, false>,
+        &index::index_region_kernel<T, P, false, false, false, true>,
+        &index::index_region_kernel<T, P, false, false, true, false>,
+        &index::index_region_kernel<T, P, false, false, true, true>,
+        &index::index_region_kernel<T, P, false, true, false, false>,
+        &index::index_region_kernel<T, P, false, true, false, true>,
+        &index::index_region_kernel<T, P, false, true, true, false>,
+        &index::index_region_kernel<T, P, false, true, true, true>,
+        &index::index_region_kernel<T, P, true, false, false, false>,
+        &index::index_region_kernel<T, P, true, false, false, true>,
+        &index::index_region_kernel<T, P, true, false, true, false>,
+        &index::index_region_kernel<T, P, true, false, true, true>,
+        &index::index_region_kernel<T, P, true, true, false, false>,
+        &index::index_region_kernel<T, P, true, true, false, true>,
+        &index::index_region_kernel<T, P, true, true, true, false>,
+        &index::index_region_kernel<T, P, true, true, true, true>,
+    };
+
+    size_t dialect = (delim_len_ > 1) << 3 | (quote != '\0') << 2 |
+                     escape_backslash_ << 1 | trim_ws_;
+
+    return (this->*kernels[dialect])(
+        source,
+        destination,
+        flags,
+        ragged,
+        delim,
+        quote,
+        start,
+        end,
+        file_offset,
+        n_max,
+        pb,
+        update_size);
+  }
+
+  // Find the next newline, special character or possible multi-character
+  // delimiter from `pos`. strcspn() can only look for the first byte of the
+  // delimiter, which may be common in the data, so instead 8 bytes are tested
+  // at a time for both the first and last bytes of the delimiter (and any
+  // other special characters) using 64 bit words. Candidates still need to be
+  // checked for the whole delimiter. Close to `end` this falls back to
+  // strcspn(), as words could be read past the end of the buffer.
+  template <bool quoted, bool backslash>
+  size_t find_multi_delim(
+      const char* buf,
+      size_t pos,
+      const size_t end,
+      const char* delim,
+      const char quote,
+      const char* query) const {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    // Non-zero if any byte of `v` is zero
+    auto has_zero = [&](uint64_t v) { return (v - ones) & ~v & highs; };
+
+    const char first = delim[0];
+    const char last = delim[delim_len_ - 1];
+    const uint64_t first_bytes = ones * static_cast<unsigned char>(first);
+    const uint64_t last_bytes = ones * static_cast<unsigned char>(last);
+    const uint64_t newlines = ones * '\n';
+    const uint64_t quotes = ones * static_cast<unsigned char>(quote);
+    const uint64_t backslashes = ones * '\\';
+
+    while (pos + delim_len_ + 7 <= end) {
+      uint64_t word;
+      uint64_t last_word;
+      std::memcpy(&word, buf + pos, 8);
+      std::memcpy(&last_word, buf + pos + delim_len_ - 1, 8);
+
+      uint64_t found =
+          has_zero((word ^ first_bytes) | (last_word ^ last_bytes)) |
+          has_zero(word ^ newlines);
+      if (quoted) {
+        found |= has_zero(word ^ quotes);
+      }
+      if (backslash) {
+        found |= has_zero(word ^ backslashes);
+      }
+
+      if (found) {
+        // Something in this word matched, find which byte without depending
+        // on the byte order
+        for (size_t i = 0; i < 8; ++i) {
+          const char* p = buf + pos + i;
+          if ((*p == first && p[delim_len_ - 1] == last) || *p == '\n' ||
+              (quoted && *p == quote) || (backslash && *p == '\\')) {
+            return pos + i;
+          }
+        }
+      }
+
+      pos += 8;
+    }
+
+    return pos + strcspn(buf + pos, query);
+  }
+
+  template <
+      typename T,
+      typename P,
+      bool multi_delim,
+      bool quoted,
+      bool backslash,
+      bool trim_ws>
+  size_t index_region_kernel(
+      const T& source,
+      idx_t& destination,
+      flags_t& flags,
+      ragged_region& ragged,
+      const char* delim,
+      const char quote,
+      const size_t start,
+      const size_t end,
+      const size_t file_offset,
+      const size_t n_max,
+      P& pb,
+      const size_t update_size) {
+
+    // Only stop at quotes and backslashes if they are special
+    std::array<char, 5> query = {delim[0], '\n', '\0', '\0', '\0'};
+    size_t query_size = 2;
+    if (quoted) {
+      query[query_size++] = quote;
+    }
+    if (backslash) {
+      query[query_size++] = '\\';
+    }
 
     auto last_tick = start;
     auto num_ticks = 0;
 
     bool in_quote = false;
 
+    // The flags of the current cell. The start of the first cell may be before
+    // this region, so nothing is known about it.
+    int current_flags = CELL_ALL;
+    size_t cell_start = start;
+    size_t num_quotes = 0;
+
     auto buf = source.data();
 
-    // The actual parsing is here
+    // Whitespace at either end of the cell, ignoring any windows newline
+    auto has_space = [&](size_t cell_end) {
+      if (cell_end > cell_start && buf[cell_end - 1] == '\r' &&
+          buf[cell_end] == '\n') {
+        --cell_end;
+      }
+      return cell_end > cell_start &&
+             (buf[cell_start] == ' ' || buf[cell_start] == '\t' ||
+              buf[cell_end - 1] == ' ' || buf[cell_end - 1] == '\t');
+    };
+
+    auto next_cell = [&](size_t next_start) {
+      current_flags = 0;
+      cell_start = next_start;
+      num_quotes = 0;
+    };
+
+    auto push_cell = [&](size_t pos, size_t next_start) {
+      if (num_quotes > 0) {
+        current_flags |= CELL_QUOTED;
+      }
+      // A quoted cell with any more quotes has escaped quotes
+      if (num_quotes > 2 && escape_double_) {
+        current_flags |= CELL_ESCAPED;
+      }
+      if (trim_ws && has_space(pos)) {
+        current_flags |= CELL_SPACE;
+      }
+      destination.push_back(pos + file_offset);
+      flags.push_back(current_flags);
+      next_cell(next_start);
+    };
+
+    // Rows with too many fields are truncated, and rows with too few padded
+    // with missing cells, so every row has columns_ cells and cells can be
+    // found by position. This is not checked for the first row, which sets
+    // the number of columns.
+    const bool check_fields = columns_ > 0;
+    const size_t max_fields = check_fields ? columns_ : -1;
+    size_t fields = ragged.fields;
+
+    // When sparse the cells of each row are pushed as usual, then replaced by
+    // the end of the row once it is complete. `row_start` is the position in
+    // `destination` of the first cell of the current row.
+    const bool sparse = sparse_ && check_fields;
+    size_t row_start =
+        sparse ? destination.size() - std::min(fields, columns_) : 0;
+
+    // Skips any lines from `line_start`, moving the offset of the last cell
+    // to the end of the skipped lines so the next row starts in the right
+    // place
+    auto skip_from = [&](size_t line_start) {
+      size_t next_row = skip_lines(buf, line_start, end, ragged.skip);
+      if (next_row != line_start) {
+        destination.back() = next_row - 1 + file_offset;
+        flags.back() |= CELL_SKIPPED_LINES;
+        cell_start = next_row;
+      }
+      return next_row;
+    };
+
+    // The actual parsing is here, carrying on skipping lines if the last call
+    // stopped in them
     size_t pos = start;
+    if (ragged.skip != SKIP_NONE) {
+      pos = skip_from(pos);
+    }
     size_t lines_read = 0;
     while (pos < end) {
-      size_t buf_offset = strcspn(buf + pos, query.data());
-      pos = pos + buf_offset;
+      if (multi_delim) {
+        pos = find_multi_delim<quoted, backslash>(
+            buf, pos, end, delim, quote, query.data());
+      } else {
+        size_t buf_offset = strcspn(buf + pos, query.data());
+        pos = pos + buf_offset;
+      }
       auto c = buf[pos];
 
-      if (!in_quote && strncmp(delim, buf + pos, delim_len_) == 0) {
-        destination.push_back(pos + file_offset);
+      // A newline delimiter (for files with one column) still ends the row
+      bool is_delim = multi_delim ? strncmp(delim, buf + pos, delim_len_) == 0
+                                  : c == delim[0] && c != '\n';
+
+      if (!in_quote && is_delim) {
+        if (fields < max_fields) {
+          push_cell(pos, pos + delim_len_);
+        } else {
+          next_cell(pos + delim_len_);
+        }
+        ++fields;
       }
 
       else if (c == '\n') { // no embedded quotes allowed
-        destination.push_back(pos + file_offset);
+        // The newline a region starts with is not the end of a row to check
+        size_t found = fields + 1;
+        bool region_start = destination.empty();
+        if (!check_fields || found == columns_ || region_start) {
+          push_cell(pos, pos + 1);
+        } else if (sparse) {
+          // Fields are found when reading, so only the row needs recording
+          push_cell(pos, pos + 1);
+          ragged.rows.push_back(
+              {row_start + sparse_cells_per_row() - 1, found, 0});
+        } else if (found < columns_) {
+          // Unlike the last column, this cell does not include any windows
+          // newline
+          size_t cell_end = pos;
+          if (windows_newlines_ && pos > cell_start && buf[pos - 1] == '\r') {
+            --cell_end;
+          }
+          push_cell(cell_end, pos + 1);
+          for (size_t i = found; i < columns_; ++i) {
+            destination.push_back(pos + file_offset);
+            flags.push_back(CELL_MISSING);
+          }
+          ragged.rows.push_back({destination.size() - 1, found, 0});
+        } else {
+          // The last kept cell ends at a delimiter, but its offset is moved
+          // to the newline so the next row starts in the right place
+          ragged.rows.push_back(
+              {destination.size() - 1, found, destination.back()});
+          destination.back() = pos + file_offset;
+          flags.back() |= CELL_TRUNCATED;
+          next_cell(pos + 1);
+        }
+        fields = 0;
+
+        if (sparse && region_start) {
+          row_start = destination.size();
+        } else if (sparse) {
+          // Keep the end of every sparse_fields'th cell, then the end of the
+          // row. Cells past the end of a short row end at its newline, as do
+          // any missing cells, so they are read as empty.
+          size_t pushed = destination.size() - row_start;
+          size_t kept = sparse_cells_per_row();
+          size_t row_end = destination.back();
+          if (pushed < kept) {
+            destination.resize(row_start + kept);
+          }
+          for (size_t j = 1; j < kept; ++j) {
+            size_t cell = j * sparse_fields - 1;
+            destination[row_start + j - 1] =
+                cell < pushed ? destination[row_start + cell] : row_end;
+          }
+          destination[row_start + kept - 1] = row_end;
+          destination.resize(row_start + kept);
+          flags.resize(row_start + kept);
+          row_start += kept;
+        }
+
         if (lines_read >= n_max) {
           if (progress_ && pb) {
             pb->finish();
           }
+          ragged.fields = fields;
           return lines_read;
         }
         ++lines_read;
@@ -353,13 +955,18 @@ public:
             ++num_ticks;
           }
         }
+
+        ragged.skip = SKIP_LINE_START;
+        pos = skip_from(pos + 1) - 1;
       }
 
-      else if (c == quote) {
+      else if (quoted && c == quote) {
         in_quote = !in_quote;
+        ++num_quotes;
       }
 
-      else if (escape_backslash_ && c == '\\') {
+      else if (backslash && c == '\\') {
+        current_flags |= CELL_ESCAPED;
         ++pos;
       }
 
@@ -369,6 +976,7 @@ public:
     if (progress_ && pb) {
       pb->tick(end - last_tick);
     }
+    ragged.fields = fields;
     return lines_read;
   }
 };
@@ -383,15 +991,7 @@ namespace std {
 
 template <> struct hash<vroom::string> {
   std::size_t operator()(const vroom::string& k) const {
-    const char* begin = k.begin();
-    const char* end = k.end();
-
-    size_t result = 0;
-    const size_t prime = 31;
-    while (begin != end) {
-      result = *begin++ + (result * prime);
-    }
-    return result;
+    return vroom::hash_bytes(k.begin(), k.end());
   }
 };
 
@@ -6,120 +6,6 @@
 using namespace vroom;
 using namespace Rcpp;
 
-// Class index_collection::column::iterator
-
-index_collection::column::full_iterator::full_iterator(
-    std::shared_ptr<const index_collection> idx, size_t column)
-    : i_(0),
-      idx_(idx),
-      column_(column),
-      start_(0),
-      end_(idx_->indexes_.size() - 1),
-      it_(idx_->indexes_[i_]->get_column(column_).begin()),
-      it_end_(idx_->indexes_[i_]->get_column(column_).end()),
-      it_start_(idx_->indexes_[i_]->get_column(column_).begin()) {
-  SPDLOG_TRACE("{0:x}: full_iterator ctor", (size_t)this);
-}
-
-void index_collection::column::full_iterator::next() {
-  ++it_;
-  if (it_ == it_end_ && i_ < end_) {
-    ++i_;
-    it_ = idx_->indexes_[i_]->get_column(column_).begin();
-    it_end_ = idx_->indexes_[i_]->get_column(column_).end();
-  }
-}
-
-void index_collection::column::full_iterator::prev() {
-  --it_;
-  if (it_ == it_start_ && i_ > start_) {
-    --i_;
-    it_ = idx_->indexes_[i_]->get_column(column_).end();
-    it_start_ = idx_->indexes_[i_]->get_column(column_).begin();
-  }
-}
-
-void index_collection::column::full_iterator::advance(ptrdiff_t n) {
-  if (n == 0) {
-    return;
-  }
-  if (n > 0) {
-    while (n > 0) {
-      auto diff = it_end_ - it_;
-      if (n < diff) {
-        it_ += n;
-        return;
-      }
-      it_ += (diff - 1);
-      n -= diff;
-      next();
-    }
-    return;
-  }
-  if (n < 0) {
-    while (n < 0) {
-      auto diff = it_start_ - it_;
-      if (n > diff) {
-        it_ -= n;
-        return;
-      }
-      it_ -= (diff + 1);
-      n += diff;
-      prev();
-    }
-    return;
-  }
-}
-
-ptrdiff_t index_collection::column::full_iterator::distance_to(
-    const base_iterator& that) const {
-
-  auto that_ = static_cast<const full_iterator&>(that);
-
-  if (i_ == that_.i_) {
-    ptrdiff_t res = that_.it_ - it_;
-    return res;
-  }
-  ptrdiff_t count = 0;
-  size_t i = i_;
-
-  if (i_ < that_.i_) {
-    count = it_end_ - it_;
-    ++i;
-    while (i < that_.i_) {
-      count += idx_->indexes_[i]->num_rows();
-      ++i;
-    }
-    auto begin = idx_->indexes_[i]->get_column(column_).begin();
-    count += that_.it_ - begin;
-    return count;
-  }
-
-  count = it_start_ - it_;
-  --i;
-  while (i > that_.i_) {
-    count -= idx_->indexes_[i]->num_rows();
-    --i;
-  }
-  auto end = idx_->indexes_[i]->get_column(column_).end();
-  count += that_.it_ - end;
-  return count;
-}
-
-string index_collection::column::full_iterator::value() const { return *it_; }
-
-index_collection::column::full_iterator*
-index_collection::column::full_iterator::clone() const {
-
-  SPDLOG_TRACE("{0:x}: full_iterator clone", (size_t)this);
-  auto copy = new index_collection::column::full_iterator(*this);
-  return copy;
-}
-
-string index_collection::column::full_iterator::at(ptrdiff_t n) const {
-  return idx_->get(n, column_);
-}
-
 // Index_collection
 index_collection::index_collection(
     Rcpp::List in,
@@ -133,7 +19,8 @@ index_collection::index_collection(
     const size_t n_max,
     const char comment,
     const size_t num_threads,
-    const bool progress)
+    const bool progress,
+    const bool sparse)
     : rows_(0), columns_(0) {
 
   Rcpp::Function standardise_one_path =
@@ -158,7 +45,8 @@ index_collection::index_collection(
           n_max,
           comment,
           get_env("VROOM_CONNECTION_SIZE", 1 << 17),
-          progress));
+          progress,
+          sparse));
     } else {
       auto filename = as<std::string>(x);
       p = std::unique_ptr<vroom::index>(new vroom::index(
@@ -173,7 +61,8 @@ index_collection::index_collection(
           n_max,
           comment,
           num_threads,
-          progress));
+          progress,
+          sparse));
     }
     rows_ += p->num_rows();
     columns_ = p->num_columns();
@@ -183,13 +72,33 @@ index_collection::index_collection(
   }
 }
 
-const string index_collection::get(size_t row, size_t column) const {
+const string index_collection::get(
+    size_t row, size_t column, string_arena& arena) const {
   for (const auto& idx : indexes_) {
     if (row < idx->num_rows()) {
-      return idx->get(row, column);
+      return idx->get(row, column, arena);
     }
     row -= idx->num_rows();
   }
   /* should never get here */
-  return std::string("");
+  static const char empty[] = "";
+  return {empty, empty};
+}
+
+void index_collection::get_cells(
+    size_t row, size_t column, size_t n, cell* out) const {
+  for (const auto& idx : indexes_) {
+    if (n == 0) {
+      return;
+    }
+    if (row < idx->num_rows()) {
+      size_t len = std::min(n, idx->num_rows() - row);
+      idx->get_cells(row, column, len, out);
+      out += len;
+      n -= len;
+      row = 0;
+    } else {
+      row -= idx->num_rows();
+    }
+  }
 }
@@ -27,9 +27,21 @@ public:
       const size_t n_max,
       const char comment,
       const size_t num_threads,
-      const bool progress);
+      const bool progress,
+      const bool sparse);
 
-  const string get(size_t row, size_t col) const;
+  // Escaped values are stored in `arena`
+  const string get(size_t row, size_t col, string_arena& arena) const;
+
+  // Find the cells of `n` rows of column `col`, starting at `row`, which may
+  // span several files. See index::get_cells().
+  void get_cells(size_t row, size_t col, size_t n, cell* out) const;
+
+  // All files are read with the same options, so any of them can unescape a
+  // cell
+  const string get_string(const cell& c, string_arena& arena) const {
+    return indexes_[0]->get_string(c, arena);
+  }
 
   size_t num_columns() const { return columns_; }
 
@@ -43,6 +55,21 @@ public:
     return out;
   }
 
+  // The rows of all files which were padded or truncated to the number of
+  // columns, numbered within the collection
+  std::vector<ragged_row> ragged_rows() const {
+    std::vector<ragged_row> out;
+    size_t rows_before = 0;
+    for (const auto& index : indexes_) {
+      for (auto row : index->ragged_rows()) {
+        row.row += rows_before;
+        out.push_back(row);
+      }
+      rows_before += index->num_rows();
+    }
+    return out;
+  }
+
   std::vector<size_t> row_sizes() const {
     std::vector<size_t> out;
     for (const auto& index : indexes_) {
@@ -51,218 +78,224 @@ public:
     return out;
   }
 
+  // A column of the collection, either all of its rows or a subset of them.
+  //
+  // Iterators over a column are plain values, so copying and advancing them
+  // needs no allocation or virtual calls. They are valid as long as the column
+  // they came from exists. Values read with an iterator or operator[] are
+  // valid until the next value is read from the same column, so a column
+  // should not be read from several threads at once, use a slice per thread.
   class column {
 
   public:
-    class base_iterator {
-    public:
-      virtual void next() = 0;
-      virtual void prev() = 0;
-      virtual void advance(ptrdiff_t n) = 0;
-      virtual bool equal_to(const base_iterator& it) const = 0;
-      virtual ptrdiff_t distance_to(const base_iterator& it) const = 0;
-      virtual string value() const = 0;
-      virtual base_iterator* clone() const = 0;
-      virtual string at(ptrdiff_t n) const = 0;
-      virtual ~base_iterator() {
-        SPDLOG_TRACE("{0:x}: base_iterator dtor", (size_t)this);
-      }
-    };
-
     class iterator {
-      base_iterator* it_;
+      const index_collection* idx_;
+
+      // For subsets the row in the collection of each position, otherwise
+      // NULL and the position is the row
+      const std::vector<size_t>* rows_;
+      size_t column_;
+      size_t i_;
+      string_arena* arena_;
+
+      // The file containing the last row read, so sequential reads don't need
+      // to search for it
+      mutable const index* file_;
+      mutable size_t file_start_;
+      mutable size_t file_end_;
 
     public:
-      using iterator_category = std::forward_iterator_tag;
+      using iterator_category = std::random_access_iterator_tag;
       using value_type = string;
       using pointer = string*;
       using reference = string&;
-
-      iterator(base_iterator* it) : it_(it) {
-        SPDLOG_TRACE("{0:x}: iterator ctor", (size_t)this);
-      }
-
-      iterator& operator=(const iterator& other) = delete;
-      //{
-      // SPDLOG_TRACE("{0:x}: iterator assignment", (size_t)this);
-
-      // base_iterator* original = it_;
-      // it_ = other.it_->clone();
-      // delete original;
-
-      // return *this;
-      //}
-
-      iterator(const iterator& other) : it_(other.it_->clone()) {
-        SPDLOG_TRACE("{0:x}: iterator cctor", (size_t)this);
-      }
+      using difference_type = ptrdiff_t;
+
+      iterator(
+          const index_collection* idx,
+          const std::vector<size_t>* rows,
+          size_t column,
+          size_t i,
+          string_arena* arena)
+          : idx_(idx),
+            rows_(rows),
+            column_(column),
+            i_(i),
+            arena_(arena),
+            file_(nullptr),
+            file_start_(0),
+            file_end_(0) {}
 
       iterator operator++(int) { /* postfix */
         iterator copy(*this);
-        it_->next();
+        ++i_;
         return copy;
       }
 
       iterator& operator++() /* prefix */ {
-        it_->next();
+        ++i_;
         return *this;
       }
 
       iterator operator--(int) { /* postfix */
         iterator copy(*this);
-        it_->prev();
+        --i_;
         return copy;
       }
 
       iterator& operator--() /* prefix */ {
-        it_->prev();
+        --i_;
         return *this;
       }
 
-      bool operator!=(const iterator& other) const {
-        return !it_->equal_to(*other.it_);
-      }
+      bool operator!=(const iterator& other) const { return i_ != other.i_; }
 
-      bool operator==(const iterator& other) const {
-        return it_->equal_to(*other.it_);
-      }
+      bool operator==(const iterator& other) const { return i_ == other.i_; }
 
-      string operator*() const { return it_->value(); }
+      string operator*() const {
+        size_t row = rows_ ? (*rows_)[i_] : i_;
+        if (row < file_start_ || row >= file_end_) {
+          find_file(row);
+        }
+        arena_->reset();
+        return file_->get(row - file_start_, column_, *arena_);
+      }
 
       iterator& operator+=(ptrdiff_t n) {
-        it_->advance(n);
+        i_ += n;
         return *this;
       }
-      iterator operator+(ptrdiff_t n) const {
-
-        SPDLOG_TRACE("{0:x}: iterator operator+({1})", (size_t)this, n);
 
+      iterator operator+(ptrdiff_t n) const {
         iterator copy(*this);
-        copy.it_->advance(n);
+        copy.i_ += n;
         return copy;
       }
 
       iterator operator-(ptrdiff_t n) const {
         iterator copy(*this);
-        copy.it_->advance(-n);
+        copy.i_ -= n;
         return copy;
       }
 
       ptrdiff_t operator-(const iterator& other) const {
-        return -it_->distance_to(*other.it_);
+        return ptrdiff_t(i_) - ptrdiff_t(other.i_);
       }
 
-      string operator[](ptrdiff_t n) const { return it_->at(n); }
-
-      ~iterator() {
-        SPDLOG_TRACE("{0:x}: iterator dtor", (size_t)this);
-        delete it_;
+      string operator[](ptrdiff_t n) const { return *(*this + n); }
+
+    private:
+      void find_file(size_t row) const {
+        size_t start = 0;
+        for (const auto& idx : idx_->indexes_) {
+          size_t end = start + idx->num_rows();
+          if (row < end) {
+            file_ = idx.get();
+            file_start_ = start;
+            file_end_ = end;
+            return;
+          }
+          start = end;
+        }
       }
     };
 
-    class full_iterator : public base_iterator {
-      size_t i_;
-      std::shared_ptr<const index_collection> idx_;
-      size_t column_;
-      size_t start_;
-      size_t end_;
-      index::column::iterator it_;
-      index::column::iterator it_end_;
-      index::column::iterator it_start_;
-
-    public:
-      full_iterator(std::shared_ptr<const index_collection> idx, size_t column);
-      void next();
-      void prev();
-      void advance(ptrdiff_t n);
-      inline bool equal_to(const base_iterator& other) const {
-        return i_ == static_cast<const full_iterator&>(other).i_ &&
-               it_ == static_cast<const full_iterator&>(other).it_;
-      }
-      ptrdiff_t distance_to(const base_iterator& it) const;
-      string value() const;
-      full_iterator* clone() const;
-      string at(ptrdiff_t n) const;
-      virtual ~full_iterator() {
-        SPDLOG_TRACE("{0:x}: full_iterator dtor", (size_t)this);
-      }
-    };
+    iterator begin() const {
+      return iterator(idx_.get(), rows_.get(), column_, begin_, &arena_);
+    }
+    iterator end() const {
+      return iterator(idx_.get(), rows_.get(), column_, end_, &arena_);
+    }
 
-    class subset_iterator : public base_iterator {
-      size_t i_;
-      iterator it_;
-      std::shared_ptr<std::vector<size_t> > indexes_;
+    column slice(size_t start, size_t end) const {
+      return column(idx_, rows_, column_, begin_ + start, begin_ + end);
+    }
 
-    public:
-      subset_iterator(
-          const iterator& it,
-          const std::shared_ptr<std::vector<size_t> >& indexes)
-          : i_(0), it_(it), indexes_(indexes) {
-        SPDLOG_TRACE("{0:x}: subset_iterator ctor", (size_t)this);
+    // Subsets of subsets are flattened to rows of the collection, so each
+    // value is always looked up directly.
+    column subset(const std::shared_ptr<std::vector<size_t> >& idx) const {
+      auto rows = std::make_shared<std::vector<size_t> >();
+      rows->reserve(idx->size());
+      for (auto i : *idx) {
+        rows->push_back(row(begin_ + i));
       }
-      void next() { ++i_; }
-      void prev() { --i_; }
-      void advance(ptrdiff_t n) { i_ += n; }
-      bool equal_to(const base_iterator& other) const {
-        auto other_ = static_cast<const subset_iterator&>(other);
-        return i_ == other_.i_;
-      };
-      ptrdiff_t distance_to(const base_iterator& that) const {
-        auto that_ = static_cast<const subset_iterator&>(that);
-        return that_.i_ - i_;
-      };
-      string value() const { return *(it_ + (*indexes_)[i_]); };
-      subset_iterator* clone() const {
-        SPDLOG_TRACE("{0:x}: subset_iterator clone", (size_t)this);
-        auto copy = new index_collection::column::subset_iterator(*this);
-        return copy;
-      };
+      return column(idx_, rows, column_, 0, rows->size());
+    }
 
-      string at(ptrdiff_t n) const { return it_[(*indexes_)[n]]; }
+    size_t size() const { return end_ - begin_; }
+    string operator[](size_t i) const {
+      arena_.reset();
+      return idx_->get(row(begin_ + i), column_, arena_);
+    }
 
-      virtual ~subset_iterator() {
-        SPDLOG_TRACE("{0:x}: subset_iterator dtor", (size_t)this);
+    // Find the cells of `n` values starting at `i`. Runs of consecutive rows
+    // in subsets are looked up together.
+    void get_cells(size_t i, size_t n, cell* out) const {
+      if (!rows_) {
+        idx_->get_cells(begin_ + i, column_, n, out);
+        return;
       }
-    };
 
-    iterator begin() const { return begin_; }
-    iterator end() const { return end_; }
-
-    column slice(size_t start, size_t end) const {
-      return {begin_ + start, begin_ + end};
+      size_t pos = begin_ + i;
+      size_t end = pos + n;
+      while (pos < end) {
+        size_t first = (*rows_)[pos];
+        size_t len = 1;
+        while (pos + len < end && (*rows_)[pos + len] == first + len) {
+          ++len;
+        }
+        idx_->get_cells(first, column_, len, out);
+        out += len;
+        pos += len;
+      }
     }
 
-    column subset(const std::shared_ptr<std::vector<size_t> >& idx) const {
-      auto begin = new subset_iterator(begin_, idx);
-      auto end = new subset_iterator(begin_, idx);
-      end->advance(idx->size());
-      return {begin, end};
+    // Call `f` with each value in turn. The cells are found in batches with
+    // get_cells(), which is much cheaper than dereferencing an iterator for
+    // each value, so this is what parsers should use. Values are only valid
+    // during the call to `f`.
+    template <typename F> void for_each(F f) const {
+      const size_t batch_size = 256;
+      cell cells[batch_size];
+      string_arena arena;
+      size_t n = size();
+      for (size_t i = 0; i < n; i += batch_size) {
+        size_t len = std::min(batch_size, n - i);
+        get_cells(i, len, cells);
+        arena.reset();
+        for (size_t j = 0; j < len; ++j) {
+          f(idx_->get_string(cells[j], arena));
+        }
+      }
     }
 
-    size_t size() const { return end_ - begin_; }
-    string operator[](size_t i) const { return begin_[i]; }
-
     column() = delete;
-    column(base_iterator* begin, base_iterator* end)
-        : begin_(begin), end_(end) {
-      SPDLOG_TRACE("{0:x}: column ctor 1", (size_t)this);
-    };
-
-    column(const iterator& begin, const iterator& end)
-        : begin_(begin), end_(end) {
-      SPDLOG_TRACE("{0:x}: column ctor 2", (size_t)this);
+    column(
+        const std::shared_ptr<const index_collection>& idx,
+        const std::shared_ptr<std::vector<size_t> >& rows,
+        size_t column,
+        size_t begin,
+        size_t end)
+        : idx_(idx), rows_(rows), column_(column), begin_(begin), end_(end) {
+      SPDLOG_TRACE("{0:x}: column ctor", (size_t)this);
     };
 
   private:
-    const iterator begin_;
-    const iterator end_;
+    size_t row(size_t i) const { return rows_ ? (*rows_)[i] : i; }
+
+    std::shared_ptr<const index_collection> idx_;
+    std::shared_ptr<std::vector<size_t> > rows_;
+    size_t column_;
+    size_t begin_;
+    size_t end_;
+
+    // Storage for escaped values read with iterators or operator[]
+    mutable string_arena arena_;
   };
 
   column get_column(size_t num) const {
     SPDLOG_TRACE("{0:x}: get_column()", (size_t)this);
-    auto end = new column::full_iterator(shared_from_this(), num);
-    end->advance(rows_);
-    return {new column::full_iterator(shared_from_this(), num), end};
+    return column(shared_from_this(), nullptr, num, 0, rows_);
   }
 
   index::row row(size_t row) const {
@@ -25,7 +25,8 @@ index_connection::index_connection(
     size_t n_max,
     const char comment,
     const size_t chunk_size,
-    const bool progress) {
+    const bool progress,
+    const bool sparse) {
 
   has_header_ = has_header;
   quote_ = quote;
@@ -35,6 +36,7 @@ index_connection::index_connection(
   comment_ = comment;
   skip_ = skip;
   progress_ = progress;
+  sparse_ = sparse;
 
   filename_ = Rcpp::as<std::string>(Rcpp::as<Rcpp::Function>(
       Rcpp::Environment::namespace_env("vroom")["vroom_tempfile"])());
@@ -56,8 +58,8 @@ index_connection::index_connection(
   auto i = 0;
 
   idx_ = std::vector<idx_t>(2);
-
-  idx_[0].reserve(128);
+  flags_ = std::vector<flags_t>(2);
+  ragged_ = std::vector<ragged_region>(2);
 
   auto sz = R_ReadConnection(con, buf[i].data(), chunk_size - 1);
   buf[i][sz] = '\0';
@@ -65,7 +67,6 @@ index_connection::index_connection(
   // Parse header
   auto start = find_first_line(buf[i]);
 
-  std::string delim_;
   if (delim == nullptr) {
     delim_ = std::string(1, guess_delim(buf[i], start));
   } else {
@@ -92,9 +93,12 @@ index_connection::index_connection(
 
   // Index the first row
   idx_[0].push_back(start - 1);
+  flags_[0].push_back(0);
   size_t lines_read = index_region(
       buf[i],
       idx_[0],
+      flags_[0],
+      ragged_[0],
       delim_.c_str(),
       quote,
       start,
@@ -126,6 +130,8 @@ index_connection::index_connection(
       lines_read = index_region(
           buf[i],
           idx_[1],
+          flags_[1],
+          ragged_[1],
           delim_.c_str(),
           quote,
           first_nl,
@@ -182,13 +188,7 @@ index_connection::index_connection(
     throw Rcpp::exception(error.message().c_str(), false);
   }
 
-  auto total_size = std::accumulate(
-      idx_.begin(), idx_.end(), 0, [](size_t sum, const idx_t& v) {
-        sum += v.size() - 1;
-        return sum;
-      });
-
-  rows_ = columns_ > 0 ? total_size / columns_ : 0;
+  rows_ = count_rows();
 
   if (rows_ > 0 && has_header_) {
     --rows_;
@@ -199,8 +199,8 @@ index_connection::index_connection(
   auto log = spdlog::basic_logger_mt(
       "basic_logger", "logs/index_connection.idx", true);
   for (auto& i : idx_) {
-    for (auto& v : i) {
-      SPDLOG_LOGGER_DEBUG(log, "{}", v);
+    for (size_t j = 0; j < i.size(); ++j) {
+      SPDLOG_LOGGER_DEBUG(log, "{}", i[j]);
     }
     SPDLOG_LOGGER_DEBUG(log, "end of idx {0:x}", (size_t)&i);
   }
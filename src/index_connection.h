@@ -42,7 +42,8 @@ public:
       const size_t n_max,
       const char comment,
       const size_t chunk_size,
-      const bool progress);
+      const bool progress,
+      const bool sparse);
 
   ~index_connection() { unlink(filename_.c_str()); }
 };
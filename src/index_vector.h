@@ -0,0 +1,193 @@
+#ifndef VROOM_INDEX_VECTOR_H_
+#define VROOM_INDEX_VECTOR_H_
+
+// clang-format off
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wsign-compare"
+#include <mio/mmap.hpp>
+# pragma clang diagnostic pop
+// clang-format on
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vroom {
+
+// The storage of one region of the index, a minimal std::vector whose
+// elements can also be kept in a temporary file mapped into memory. The
+// operating system then writes back and drops pages of the file as needed,
+// so the index can be larger than the available memory.
+//
+// The elements are stored in pages of a fixed size, so growing never copies
+// the elements already added and no more memory is used than needed. Only
+// the first page grows like a std::vector, so small regions stay small. In
+// a file the pages are taken from mappings of segments of the file, which
+// double in size up to max_segment_pages, so even indexes far larger than
+// memory need few mappings.
+//
+// Only the thread indexing a region appends to it, so no locking is done.
+template <typename T> class index_vector {
+  static const size_t page_bits = 16;
+  static const size_t page_size = size_t(1) << page_bits;
+  static const size_t page_mask = page_size - 1;
+  static const size_t min_segment_pages = 16;
+  static const size_t max_segment_pages = 2048;
+
+public:
+  index_vector()
+      : size_(0), capacity_(0), file_size_(0), segment_pages_(0),
+        segment_pages_used_(0) {}
+
+  index_vector(const index_vector&) = delete;
+  index_vector& operator=(const index_vector&) = delete;
+
+  ~index_vector() { release(); }
+
+  // Store the pages in a new file at `filename`, which is removed again with
+  // the elements. Throws if the file cannot be created, or later grown.
+  void use_file(const std::string& filename) {
+    release();
+    std::FILE* out = std::fopen(filename.c_str(), "wb");
+    if (out == nullptr) {
+      throw std::runtime_error(
+          "Could not create the index file '" + filename + "'");
+    }
+    std::fclose(out);
+    filename_ = filename;
+  }
+
+  bool in_file() const { return !filename_.empty(); }
+
+  void push_back(T value) {
+    if (size_ == capacity_) {
+      grow();
+    }
+    (*this)[size_++] = value;
+  }
+
+  T& back() { return (*this)[size_ - 1]; }
+  T back() const { return (*this)[size_ - 1]; }
+
+  T& operator[](size_t i) { return pages_[i >> page_bits][i & page_mask]; }
+  T operator[](size_t i) const {
+    return pages_[i >> page_bits][i & page_mask];
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void resize(size_t n) {
+    while (capacity_ < n) {
+      grow();
+    }
+    for (size_t i = size_; i < n; ++i) {
+      (*this)[i] = T();
+    }
+    size_ = n;
+  }
+
+private:
+  std::vector<T*> pages_;
+  size_t size_;
+  size_t capacity_;
+
+  std::vector<std::unique_ptr<T[]> > memory_;
+
+  std::string filename_;
+  std::vector<mio::mmap_sink> segments_;
+  size_t file_size_;
+  size_t segment_pages_;
+  size_t segment_pages_used_;
+
+  void grow() {
+    if (in_file()) {
+      pages_.push_back(file_page());
+    } else if (capacity_ < page_size) {
+      size_t capacity = capacity_ == 0 ? 64 : capacity_ * 2;
+      grow_first_page(capacity < page_size ? capacity : page_size);
+      return;
+    } else {
+      memory_.emplace_back(new T[page_size]);
+      pages_.push_back(memory_.back().get());
+    }
+    capacity_ += page_size;
+  }
+
+  void grow_first_page(size_t capacity) {
+    std::unique_ptr<T[]> page(new T[capacity]);
+    if (size_ > 0) {
+      std::memcpy(page.get(), pages_[0], size_ * sizeof(T));
+    }
+    pages_.assign(1, page.get());
+    memory_.clear();
+    memory_.push_back(std::move(page));
+    capacity_ = capacity;
+  }
+
+  // The next unused page of the last segment of the file, adding a segment
+  // if it is full
+  T* file_page() {
+    if (segments_.empty()) {
+      map_segment(min_segment_pages);
+    } else if (segment_pages_used_ == segment_pages_) {
+      size_t pages = segment_pages_ * 2;
+      map_segment(pages < max_segment_pages ? pages : max_segment_pages);
+    }
+    T* segment = reinterpret_cast<T*>(segments_.back().data());
+    return segment + segment_pages_used_++ * page_size;
+  }
+
+  // Grows the file by a segment of `pages` pages and maps it
+  void map_segment(size_t pages) {
+    size_t bytes = pages * page_size * sizeof(T);
+    {
+      std::fstream out(
+          filename_, std::ios::in | std::ios::out | std::ios::binary);
+      out.seekp(file_size_ + bytes - 1);
+      out.put('\0');
+      out.close();
+      if (out.fail()) {
+        throw std::runtime_error(
+            "Could not grow the index file '" + filename_ + "'");
+      }
+    }
+
+    std::error_code error;
+    mio::mmap_sink segment =
+        mio::make_mmap_sink(filename_, file_size_, bytes, error);
+    if (error) {
+      throw std::runtime_error(
+          "Could not map the index file '" + filename_ +
+          "': " + error.message());
+    }
+    segments_.push_back(std::move(segment));
+    file_size_ += bytes;
+    segment_pages_ = pages;
+    segment_pages_used_ = 0;
+  }
+
+  void release() {
+    segments_.clear();
+    if (in_file()) {
+      std::remove(filename_.c_str());
+      filename_.clear();
+    }
+    memory_.clear();
+    pages_.clear();
+    size_ = 0;
+    capacity_ = 0;
+    file_size_ = 0;
+    segment_pages_ = 0;
+    segment_pages_used_ = 0;
+  }
+};
+
+} // namespace vroom
+
+#endif
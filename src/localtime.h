@@ -1,3 +1,6 @@
+#ifndef VROOM_LOCALTIME_H_
+#define VROOM_LOCALTIME_H_
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,3 +25,5 @@ time_t my_mktime(stm* const tmp, const char* name);
 #ifdef __cplusplus
 }
 #endif
+
+#endif
@@ -9,6 +9,7 @@
 #include "vroom_dbl.h"
 #include "vroom_dttm.h"
 #include "vroom_fct.h"
+#include "vroom_filter.h"
 #include "vroom_int.h"
 #include "vroom_lgl.h"
 #include "vroom_num.h"
@@ -71,6 +72,42 @@ CharacterVector generate_filename_column(
   return wrap(out);
 }
 
+// The rows with a different number of fields than there are columns, with
+// the same columns as readr::problems()
+List generate_problems(
+    const std::vector<vroom::ragged_row>& rows,
+    const std::vector<std::string>& filenames,
+    const std::vector<size_t>& lengths,
+    size_t columns) {
+  IntegerVector row(rows.size());
+  CharacterVector col(rows.size());
+  CharacterVector expected(rows.size());
+  CharacterVector actual(rows.size());
+  CharacterVector file(rows.size());
+
+  std::string expected_str = std::to_string(columns) + " columns";
+
+  size_t file_num = 0;
+  size_t file_end = lengths.empty() ? 0 : lengths[0];
+  for (size_t i = 0; i < rows.size(); ++i) {
+    while (rows[i].row >= file_end && file_num + 1 < lengths.size()) {
+      file_end += lengths[++file_num];
+    }
+    row[i] = rows[i].row + 1;
+    col[i] = NA_STRING;
+    expected[i] = expected_str;
+    actual[i] = std::to_string(rows[i].fields) + " columns";
+    file[i] = filenames[file_num];
+  }
+
+  return List::create(
+      Named("row") = row,
+      Named("col") = col,
+      Named("expected") = expected,
+      Named("actual") = actual,
+      Named("file") = file);
+}
+
 // [[Rcpp::export]]
 SEXP vroom_(
     List inputs,
@@ -100,7 +137,8 @@ SEXP vroom_(
     bool use_altrep_time,
     size_t guess_max,
     size_t num_threads,
-    bool progress) {
+    bool progress,
+    bool sparse_index) {
 
   Rcpp::CharacterVector tempfile;
 
@@ -108,15 +146,11 @@ SEXP vroom_(
       col_names.sexp_type() == STRSXP ||
       (col_names.sexp_type() == LGLSXP && as<LogicalVector>(col_names)[0]);
 
-  std::vector<std::string> filenames;
-
   bool add_filename = !Rf_isNull(id);
 
   // We need to retrieve filenames now before the connection objects are read,
   // as they are invalid afterwards.
-  if (add_filename) {
-    filenames = get_filenames(inputs);
-  }
+  std::vector<std::string> filenames = get_filenames(inputs);
 
   auto idx = std::make_shared<vroom::index_collection>(
       inputs,
@@ -130,7 +164,8 @@ SEXP vroom_(
       n_max,
       comment,
       num_threads,
-      progress);
+      progress,
+      sparse_index);
 
   auto total_columns = idx->num_columns();
 
@@ -186,9 +221,11 @@ SEXP vroom_(
 
     if (col_type == "collector_guess") {
       CharacterVector col_vals(guess_num);
+      vroom::string_arena arena;
       for (size_t j = 0; j < guess_num; ++j) {
         auto row = j * guess_step;
-        auto str = idx->get(row, col);
+        arena.reset();
+        auto str = idx->get(row, col, arena);
         col_vals[j] =
             locale_info->encoder_.makeSEXP(str.begin(), str.end(), false);
       }
@@ -234,9 +271,17 @@ SEXP vroom_(
         delete info;
       }
     } else if (col_type == "collector_logical") {
-      // No altrep for logicals as of R 3.5
-      res[i] = read_lgl(info);
-      delete info;
+      if (use_altrep_lgl) {
+#if defined(HAS_ALTREP) && R_VERSION >= R_Version(3, 6, 0)
+        res[i] = vroom_lgl::Make(info);
+#else
+        res[i] = read_lgl(info);
+        delete info;
+#endif
+      } else {
+        res[i] = read_lgl(info);
+        delete info;
+      }
     } else if (col_type == "collector_factor") {
       auto levels = collector["levels"];
       if (Rf_isNull(levels)) {
@@ -303,7 +348,18 @@ SEXP vroom_(
   }
 
   res.attr("names") = res_nms;
+
+  auto ragged = idx->ragged_rows();
+  if (!ragged.empty()) {
+    res.attr("problems") = generate_problems(
+        ragged, filenames, idx->row_sizes(), total_columns);
+  }
   // res.attr("filename") = idx->filenames();
 
   return res;
 }
+
+// [[Rcpp::export]]
+SEXP vroom_filter_(SEXP x, std::string op, SEXP value) {
+  return vroom_filter(x, op, value);
+}
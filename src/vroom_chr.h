@@ -1,3 +1,5 @@
+#pragma once
+
 #include "altrep.h"
 #include "vroom_vec.h"
 
@@ -10,7 +12,7 @@ Rcpp::CharacterVector read_chr(vroom_vec_info* info) {
   Rcpp::CharacterVector out(n);
 
   auto i = 0;
-  for (const auto& str : info->column) {
+  info->column.for_each([&](const string& str) {
     auto val = info->locale->encoder_.makeSEXP(str.begin(), str.end(), false);
 
     // Look for NAs
@@ -24,7 +26,7 @@ Rcpp::CharacterVector read_chr(vroom_vec_info* info) {
     }
 
     out[i++] = val;
-  }
+  });
 
   return out;
 }
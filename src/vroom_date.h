@@ -4,10 +4,16 @@
 
 using namespace vroom;
 
+// Dates without an explicit format use the locale's date format
+DateTimeFormat date_format(const vroom_vec_info& info) {
+  return DateTimeFormat(
+      info.format.empty() ? info.locale->dateFormat_ : info.format);
+}
+
 double parse_date(
-    const string& str, DateTimeParser& parser, const std::string& format) {
+    const string& str, DateTimeParser& parser, const DateTimeFormat& format) {
   parser.setDate(str.begin(), str.end());
-  bool res = (format == "") ? parser.parseLocaleDate() : parser.parse(format);
+  bool res = parser.parse(format);
 
   if (res) {
     DateTime dt = parser.makeDate();
@@ -23,14 +29,20 @@ Rcpp::NumericVector read_date(vroom_vec_info* info) {
 
   Rcpp::NumericVector out(n);
 
+  auto format = date_format(*info);
+
   parallel_for(
       n,
       [&](size_t start, size_t end, size_t id) {
         auto i = start;
         DateTimeParser parser(&*info->locale);
-        for (const auto& str : info->column.slice(start, end)) {
-          out[i++] = parse_date(str, parser, info->format);
-        }
+        dttm_cache cache;
+        auto parse = [&](const string& str) {
+          return parse_date(str, parser, format);
+        };
+        info->column.slice(start, end).for_each([&](const string& str) {
+          out[i++] = cache.get(str, parse);
+        });
       },
       info->num_threads,
       true);
@@ -52,8 +64,8 @@ public:
 
     vroom_dttm_info* dttm_info = new vroom_dttm_info;
     dttm_info->info = info;
-    dttm_info->parser =
-        std::unique_ptr<DateTimeParser>(new DateTimeParser(&*info->locale));
+    dttm_info->format = std::unique_ptr<DateTimeFormat>(
+        new DateTimeFormat(date_format(*info)));
 
     SEXP out = PROTECT(R_MakeExternalPtr(dttm_info, R_NilValue, R_NilValue));
     R_RegisterCFinalizerEx(out, vroom_dttm::Finalize, FALSE);
@@ -83,19 +95,6 @@ public:
     return TRUE;
   }
 
-  // the element at the index `i`
-  static double date_Elt(SEXP vec, R_xlen_t i) {
-    SEXP data2 = R_altrep_data2(vec);
-    if (data2 != R_NilValue) {
-      return REAL(data2)[i];
-    }
-
-    auto str = Get(vec, i);
-    auto inf = Info(vec);
-
-    return parse_date(str, *inf->parser, inf->info->format);
-  }
-
   // --- Altvec
   static SEXP Materialize(SEXP vec) {
     SEXP data2 = R_altrep_data2(vec);
@@ -105,7 +104,8 @@ public:
 
     auto inf = Info(vec);
 
-    auto out = read_date(inf->info);
+    Rcpp::NumericVector out(inf->info->column.size());
+    materialize(*inf->info, REAL(out), parser<parse_date>(*inf));
 
     R_set_altrep_data2(vec, out);
 
@@ -133,7 +133,8 @@ public:
     R_set_altvec_Extract_subset_method(class_t, Extract_subset<vroom_date>);
 
     // altreal
-    R_set_altreal_Elt_method(class_t, date_Elt);
+    R_set_altreal_Elt_method(class_t, Elt<parse_date>);
+    R_set_altreal_Get_region_method(class_t, Get_region<parse_date>);
   }
 };
 
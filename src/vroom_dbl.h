@@ -1,3 +1,5 @@
+#pragma once
+
 #include "altrep.h"
 
 #include "vroom_vec.h"
@@ -201,10 +203,10 @@ Rcpp::NumericVector read_dbl(vroom_vec_info* info) {
       n,
       [&](size_t start, size_t end, size_t id) {
         size_t i = start;
-        for (const auto& str : info->column.slice(start, end)) {
+        info->column.slice(start, end).for_each([&](const string& str) {
           SPDLOG_DEBUG("read_dbl(start: {} end: {} i: {})", start, end, i);
           out[i++] = bsd_strtod(str.begin(), str.end());
-        }
+        });
       },
       info->num_threads,
       true);
@@ -253,6 +255,13 @@ public:
 
   // ALTREAL methods -----------------
 
+  // Parse a slice of the column into `out`
+  static void Parse(const index_collection::column& col, double* out) {
+    col.for_each([&](const string& str) {
+      *out++ = bsd_strtod(str.begin(), str.end());
+    });
+  }
+
   // the element at the index `i`
   static double real_Elt(SEXP vec, R_xlen_t i) {
     SEXP data2 = R_altrep_data2(vec);
@@ -260,9 +269,68 @@ public:
       return REAL(data2)[i];
     }
 
-    auto str = vroom_vec::Get(vec, i);
+    return get_elt<double>(Info(vec), i, Parse);
+  }
+
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, double* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return REAL_GET_REGION(data2, start, size, buf);
+    }
+
+    return get_region(Info(vec), start, size, buf, Parse);
+  }
+
+  // Summaries are only computed lazily if the vector is not yet materialized,
+  // otherwise returning NULL uses R's default method. R's default method is
+  // also used if there are missing values which aren't removed, to keep its
+  // rules for whether the result is NA or NaN.
+  static SEXP Sum(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<double>(Info(vec), Parse);
+    if (summary.n_na > 0 && !narm) {
+      return nullptr;
+    }
+    return Rf_ScalarReal(summary.sum);
+  }
+
+  static SEXP Min(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<double>(Info(vec), Parse);
+    if ((summary.n_na > 0 && !narm) || summary.n == 0) {
+      return nullptr;
+    }
+    return Rf_ScalarReal(summary.min);
+  }
 
-    return bsd_strtod(str.begin(), str.end());
+  static SEXP Max(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<double>(Info(vec), Parse);
+    if ((summary.n_na > 0 && !narm) || summary.n == 0) {
+      return nullptr;
+    }
+    return Rf_ScalarReal(summary.max);
+  }
+
+  static int No_NA(SEXP vec) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return 0;
+    }
+    return get_summary<double>(Info(vec), Parse).n_na == 0;
+  }
+
+  static int Is_sorted(SEXP vec) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return UNKNOWN_SORTEDNESS;
+    }
+    return get_summary<double>(Info(vec), Parse).sortedness();
   }
 
   // --- Altvec
@@ -272,7 +340,9 @@ public:
       return data2;
     }
 
-    auto out = read_dbl(&Info(vec));
+    auto& inf = Info(vec);
+    Rcpp::NumericVector out(inf.column.size());
+    materialize(inf, REAL(out), Parse);
     R_set_altrep_data2(vec, out);
 
     // Once we have materialized we no longer need the info
@@ -300,6 +370,12 @@ public:
 
     // altinteger
     R_set_altreal_Elt_method(class_t, real_Elt);
+    R_set_altreal_Get_region_method(class_t, Get_region);
+    R_set_altreal_Sum_method(class_t, Sum);
+    R_set_altreal_Min_method(class_t, Min);
+    R_set_altreal_Max_method(class_t, Max);
+    R_set_altreal_No_NA_method(class_t, No_NA);
+    R_set_altreal_Is_sorted_method(class_t, Is_sorted);
   }
 };
 
@@ -9,10 +9,69 @@
 
 using namespace vroom;
 
+// Memoizes parsed values for columns with few unique values, such as dates in
+// log files, so repeated values cost a hash lookup rather than a full parse.
+//
+// The first `sample_size` values are used to estimate the cardinality, if
+// there are too many unique values (or the cache grows beyond `max_size`) the
+// cache is disabled and values are always parsed. A cache is not thread safe,
+// so each thread should use its own.
+class dttm_cache {
+  static const size_t sample_size = 1000;
+  static const size_t max_unique_in_sample = sample_size / 4;
+  static const size_t max_size = 1 << 14;
+
+  std::unordered_map<std::string, double> values_;
+  std::string key_;
+  size_t seen_;
+  bool enabled_;
+
+public:
+  dttm_cache() : seen_(0), enabled_(true) {}
+
+  template <typename F> double get(const string& str, F parse) {
+    if (!enabled_) {
+      return parse(str);
+    }
+
+    // Reusing the key avoids allocating for each lookup
+    key_.assign(str.begin(), str.end());
+
+    double val;
+    auto search = values_.find(key_);
+    if (search != values_.end()) {
+      val = search->second;
+    } else {
+      val = parse(str);
+      values_.emplace(key_, val);
+    }
+
+    ++seen_;
+    if ((seen_ == sample_size && values_.size() > max_unique_in_sample) ||
+        values_.size() > max_size) {
+      disable();
+    }
+
+    return val;
+  }
+
+private:
+  void disable() {
+    enabled_ = false;
+    std::unordered_map<std::string, double>().swap(values_);
+  }
+};
+
+// Date times without an explicit format are parsed as ISO8601
+DateTimeFormat dttm_format(const vroom_vec_info& info) {
+  return info.format.empty() ? DateTimeFormat::ISO8601()
+                             : DateTimeFormat(info.format);
+}
+
 double parse_dttm(
-    const string& str, DateTimeParser& parser, const std::string& format) {
+    const string& str, DateTimeParser& parser, const DateTimeFormat& format) {
   parser.setDate(str.begin(), str.end());
-  bool res = (format == "") ? parser.parseISO8601() : parser.parse(format);
+  bool res = parser.parse(format);
 
   if (res) {
     DateTime dt = parser.makeDateTime();
@@ -28,15 +87,21 @@ Rcpp::NumericVector read_dttm(vroom_vec_info* info) {
 
   Rcpp::NumericVector out(n);
 
+  auto format = dttm_format(*info);
+
   parallel_for(
       n,
       [&](size_t start, size_t end, size_t id) {
         R_xlen_t i = start;
         DateTimeParser parser(&*info->locale);
-        for (const auto& str : info->column.slice(start, end)) {
+        dttm_cache cache;
+        auto parse = [&](const string& str) {
+          return parse_dttm(str, parser, format);
+        };
+        info->column.slice(start, end).for_each([&](const string& str) {
           SPDLOG_DEBUG("read_dttm(start: {} end: {} i: {})", start, end, i);
-          out[i++] = parse_dttm(str, parser, info->format);
-        }
+          out[i++] = cache.get(str, parse);
+        });
       },
       info->num_threads,
       true);
@@ -53,7 +118,7 @@ Rcpp::NumericVector read_dttm(vroom_vec_info* info) {
 
 struct vroom_dttm_info {
   vroom_vec_info* info;
-  std::unique_ptr<DateTimeParser> parser;
+  std::unique_ptr<DateTimeFormat> format;
 };
 
 class vroom_dttm : public vroom_vec {
@@ -65,8 +130,8 @@ public:
 
     vroom_dttm_info* dttm_info = new vroom_dttm_info;
     dttm_info->info = info;
-    dttm_info->parser =
-        std::unique_ptr<DateTimeParser>(new DateTimeParser(&*info->locale));
+    dttm_info->format =
+        std::unique_ptr<DateTimeFormat>(new DateTimeFormat(dttm_format(*info)));
 
     SEXP out = PROTECT(R_MakeExternalPtr(dttm_info, R_NilValue, R_NilValue));
     R_RegisterCFinalizerEx(out, vroom_dttm::Finalize, FALSE);
@@ -131,17 +196,53 @@ public:
 
   // ALTREAL methods -----------------
 
+  // Parses slices of the column into `out`. Each slice gets its own
+  // parser, as they are not thread safe.
+  template <double (*parse)(
+      const string&, DateTimeParser&, const DateTimeFormat&)>
+  struct parser {
+    const DateTimeFormat& format;
+    LocaleInfo* locale;
+
+    parser(const vroom_dttm_info& inf)
+        : format(*inf.format), locale(&*inf.info->locale) {}
+
+    void operator()(const index_collection::column& col, double* out) const {
+      DateTimeParser dt_parser(locale);
+      dttm_cache cache;
+      auto parse_one = [&](const string& str) {
+        return parse(str, dt_parser, format);
+      };
+      col.for_each([&](const string& str) {
+        *out++ = cache.get(str, parse_one);
+      });
+    }
+  };
+
   // the element at the index `i`
-  static double dttm_Elt(SEXP vec, R_xlen_t i) {
+  template <double (*parse)(
+      const string&, DateTimeParser&, const DateTimeFormat&)>
+  static double Elt(SEXP vec, R_xlen_t i) {
     SEXP data2 = R_altrep_data2(vec);
     if (data2 != R_NilValue) {
       return REAL(data2)[i];
     }
 
-    auto str = Get(vec, i);
     auto inf = Info(vec);
+    return get_elt<double>(*inf->info, i, parser<parse>(*inf));
+  }
+
+  template <double (*parse)(
+      const string&, DateTimeParser&, const DateTimeFormat&)>
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, double* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return REAL_GET_REGION(data2, start, size, buf);
+    }
 
-    return parse_dttm(str, *inf->parser, inf->info->format);
+    auto inf = Info(vec);
+    return get_region(*inf->info, start, size, buf, parser<parse>(*inf));
   }
 
   // --- Altvec
@@ -153,7 +254,8 @@ public:
 
     auto inf = Info(vec);
 
-    auto out = read_dttm(inf->info);
+    Rcpp::NumericVector out(inf->info->column.size());
+    materialize(*inf->info, REAL(out), parser<parse_dttm>(*inf));
 
     R_set_altrep_data2(vec, out);
 
@@ -235,7 +337,8 @@ public:
     R_set_altvec_Extract_subset_method(class_t, Extract_subset<vroom_dttm>);
 
     // altreal
-    R_set_altreal_Elt_method(class_t, dttm_Elt);
+    R_set_altreal_Elt_method(class_t, Elt<parse_dttm>);
+    R_set_altreal_Get_region_method(class_t, Get_region<parse_dttm>);
   }
 };
 
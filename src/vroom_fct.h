@@ -1,3 +1,5 @@
+#pragma once
+
 #include "altrep.h"
 #include "vroom_vec.h"
 
@@ -14,30 +16,140 @@ bool matches(const string& needle, const std::vector<std::string>& haystack) {
   return false;
 }
 
+// An open addressing hash table of the unique values in a column, numbered
+// (from 1) in order of first appearance. The values are copied, so the table
+// does not depend on the lifetime of the strings inserted into it.
+class level_map {
+  std::vector<std::string> levels_;
+  std::vector<uint64_t> hashes_;
+
+  // 0 for an empty slot, otherwise the level
+  std::vector<size_t> slots_;
+  size_t mask_;
+
+public:
+  level_map() : slots_(64, 0), mask_(63) {}
+
+  // Returns the level of the value, or 0 if it is not in the table
+  size_t find(const char* begin, const char* end) const {
+    uint64_t hash = hash_bytes(begin, end);
+    return slots_[probe(hash, begin, end)];
+  }
+
+  // Returns the level of the value, adding it if it is new
+  size_t insert(const char* begin, const char* end) {
+    uint64_t hash = hash_bytes(begin, end);
+    size_t slot = probe(hash, begin, end);
+    if (slots_[slot] != 0) {
+      return slots_[slot];
+    }
+
+    levels_.emplace_back(begin, end);
+    hashes_.push_back(hash);
+    slots_[slot] = levels_.size();
+
+    // Keep the load factor below 1/2
+    if (levels_.size() * 2 > slots_.size()) {
+      grow();
+    }
+
+    return levels_.size();
+  }
+
+  const std::vector<std::string>& levels() const { return levels_; }
+
+private:
+  // The slot holding the value, or the empty slot where it would be added
+  size_t probe(uint64_t hash, const char* begin, const char* end) const {
+    size_t len = end - begin;
+    size_t slot = hash & mask_;
+    while (slots_[slot] != 0) {
+      size_t level = slots_[slot];
+      const std::string& existing = levels_[level - 1];
+      if (hashes_[level - 1] == hash && existing.size() == len &&
+          std::memcmp(existing.data(), begin, len) == 0) {
+        break;
+      }
+      slot = (slot + 1) & mask_;
+    }
+    return slot;
+  }
+
+  void grow() {
+    std::vector<size_t> slots(slots_.size() * 2, 0);
+    mask_ = slots.size() - 1;
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      size_t slot = hashes_[i] & mask_;
+      while (slots[slot] != 0) {
+        slot = (slot + 1) & mask_;
+      }
+      slots[slot] = i + 1;
+    }
+    slots_.swap(slots);
+  }
+};
+
+// The explicit levels of a factor, encoded in the encoding of the file so
+// values can be looked up directly from the raw bytes of each cell.
+class explicit_levels {
+  level_map levels_;
+
+  // The factor code of each value in levels_
+  std::vector<int> codes_;
+
+public:
+  explicit_levels(const Rcpp::CharacterVector& levels, LocaleInfo& locale) {
+    Iconv to_file("UTF-8", locale.encoding_);
+
+    for (R_xlen_t i = 0; i < levels.size(); ++i) {
+      SEXP level = STRING_ELT(levels, i);
+      // Values are never parsed as an NA level
+      if (level == NA_STRING) {
+        continue;
+      }
+      const char* utf8 = Rf_translateCharUTF8(level);
+
+      std::string encoded;
+      try {
+        encoded = to_file.makeString(utf8, utf8 + strlen(utf8));
+      } catch (const Rcpp::exception& e) {
+        // A level which can't be represented in the file can never match
+        continue;
+      }
+
+      size_t code =
+          levels_.insert(encoded.data(), encoded.data() + encoded.size());
+      if (code > codes_.size()) {
+        codes_.push_back(i + 1);
+      } else {
+        codes_[code - 1] = i + 1;
+      }
+    }
+  }
+
+  int find(const string& str) const {
+    size_t code = levels_.find(str.begin(), str.end());
+    if (code == 0) {
+      return NA_INTEGER;
+    }
+    return codes_[code - 1];
+  }
+};
+
 Rcpp::IntegerVector read_fctr_explicit(
     vroom_vec_info* info, Rcpp::CharacterVector levels, bool ordered) {
   R_xlen_t n = info->column.size();
 
   Rcpp::IntegerVector out(n);
-  std::unordered_map<SEXP, size_t> level_map;
-
-  for (auto i = 0; i < levels.size(); ++i) {
-    level_map[levels[i]] = i + 1;
-  }
+  explicit_levels level_map(levels, *info->locale);
 
   parallel_for(
       n,
       [&](size_t start, size_t end, size_t id) {
         size_t i = start;
-        for (const auto& str : info->column.slice(start, end)) {
-          auto search = level_map.find(
-              info->locale->encoder_.makeSEXP(str.begin(), str.end(), false));
-          if (search != level_map.end()) {
-            out[i++] = search->second;
-          } else {
-            out[i++] = NA_INTEGER;
-          }
-        }
+        info->column.slice(start, end).for_each([&](const string& str) {
+          out[i++] = level_map.find(str);
+        });
       },
       info->num_threads);
 
@@ -51,39 +163,63 @@ Rcpp::IntegerVector read_fctr_explicit(
   return out;
 }
 
+// The levels are found in three steps
+// 1. Each thread finds the unique values in its block of rows, storing the
+//    block's own level for each row.
+// 2. The blocks' levels are merged in order, which keeps the levels in order
+//    of first appearance in the whole column.
+// 3. Each thread maps its block's levels to the merged levels.
 Rcpp::IntegerVector read_fctr_implicit(vroom_vec_info* info, bool include_na) {
   R_xlen_t n = info->column.size();
 
   Rcpp::IntegerVector out(n);
-  std::vector<string> levels;
-  std::unordered_map<string, size_t> level_map;
 
   auto nas = Rcpp::as<std::vector<std::string> >(*info->na);
 
-  size_t max_level = 1;
+  std::vector<level_map> block_levels(info->num_threads);
 
-  auto start = 0;
-  auto end = n;
-  auto i = start;
-  for (const auto& str : info->column.slice(start, end)) {
-    if (include_na && matches(str, nas)) {
-      out[i++] = NA_INTEGER;
-    } else {
-      auto val = level_map.find(str);
-      if (val != level_map.end()) {
-        out[i++] = val->second;
-      } else {
-        out[i++] = max_level;
-        level_map[str] = max_level++;
-        levels.emplace_back(str);
-      }
+  parallel_for(
+      n,
+      [&](size_t start, size_t end, size_t id) {
+        auto& levels = block_levels[id];
+        size_t i = start;
+        info->column.slice(start, end).for_each([&](const string& str) {
+          if (include_na && matches(str, nas)) {
+            out[i++] = NA_INTEGER;
+          } else {
+            out[i++] = levels.insert(str.begin(), str.end());
+          }
+        });
+      },
+      info->num_threads);
+
+  level_map all_levels;
+  std::vector<std::vector<int> > remap(block_levels.size());
+  for (size_t id = 0; id < block_levels.size(); ++id) {
+    for (const auto& level : block_levels[id].levels()) {
+      remap[id].push_back(
+          all_levels.insert(level.data(), level.data() + level.size()));
     }
   }
 
+  parallel_for(
+      n,
+      [&](size_t start, size_t end, size_t id) {
+        const auto& block_remap = remap[id];
+        for (size_t i = start; i < end; ++i) {
+          if (out[i] != NA_INTEGER) {
+            out[i] = block_remap[out[i] - 1];
+          }
+        }
+      },
+      info->num_threads);
+
+  const auto& levels = all_levels.levels();
+
   Rcpp::CharacterVector out_lvls(levels.size());
   for (size_t i = 0; i < levels.size(); ++i) {
     out_lvls[i] = info->locale->encoder_.makeSEXP(
-        levels[i].begin(), levels[i].end(), false);
+        levels[i].data(), levels[i].data() + levels[i].size(), false);
   }
   if (include_na) {
     out_lvls.push_back(NA_STRING);
@@ -107,7 +243,7 @@ using namespace Rcpp;
 
 struct vroom_factor_info {
   vroom_vec_info* info;
-  std::map<SEXP, size_t> levels;
+  std::unique_ptr<explicit_levels> levels;
 };
 
 struct vroom_fct : vroom_vec {
@@ -120,10 +256,8 @@ public:
 
     vroom_factor_info* fct_info = new vroom_factor_info;
     fct_info->info = info;
-
-    for (auto i = 0; i < levels.size(); ++i) {
-      fct_info->levels[levels[i]] = i + 1;
-    }
+    fct_info->levels = std::unique_ptr<explicit_levels>(
+        new explicit_levels(levels, *info->locale));
 
     SEXP out = PROTECT(R_MakeExternalPtr(fct_info, R_NilValue, R_NilValue));
     R_RegisterCFinalizerEx(out, Finalize, FALSE);
@@ -183,32 +317,17 @@ public:
       return Rf_xlength(data2);
     }
 
-    auto inf = Info(vec);
+    auto& inf = Info(vec);
     return inf.info->column.size();
   }
 
   static inline string Get(SEXP vec, R_xlen_t i) {
-    auto inf = Info(vec);
+    auto& inf = Info(vec);
     return inf.info->column[i];
   }
 
   // ALTSTRING methods -----------------
 
-  static int Val(SEXP vec, R_xlen_t i) {
-    auto inf = Info(vec);
-
-    auto str = Get(vec, i);
-
-    auto search = inf.levels.find(
-        inf.info->locale->encoder_.makeSEXP(str.begin(), str.end(), false));
-    if (search != inf.levels.end()) {
-      return search->second;
-    }
-    // val = check_na(vec, val);
-
-    return NA_INTEGER;
-  }
-
   // the element at the index `i`
   //
   // this does not do bounds checking because that's expensive, so
@@ -219,9 +338,34 @@ public:
       return INTEGER(data2)[i];
     }
 
-    return Val(vec, i);
+    auto& inf = Info(vec);
+    return get_elt<int>(*inf.info, i, parser(*inf.levels));
   }
 
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, int* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return INTEGER_GET_REGION(data2, start, size, buf);
+    }
+
+    auto& inf = Info(vec);
+    return get_region(*inf.info, start, size, buf, parser(*inf.levels));
+  }
+
+  // Looks up slices of the column into `out`
+  struct parser {
+    const explicit_levels& levels;
+
+    parser(const explicit_levels& levels_) : levels(levels_) {}
+
+    void operator()(const index_collection::column& col, int* out) const {
+      col.for_each([&](const string& str) {
+        *out++ = levels.find(str);
+      });
+    }
+  };
+
   // --- Altvec
   static SEXP Materialize(SEXP vec) {
     SEXP data2 = R_altrep_data2(vec);
@@ -229,13 +373,11 @@ public:
       return data2;
     }
 
-    // allocate a standard character vector for data2
-    R_xlen_t n = Length(vec);
-    IntegerVector out(n);
+    auto& inf = Info(vec);
 
-    for (R_xlen_t i = 0; i < n; ++i) {
-      out[i] = Val(vec, i);
-    }
+    // allocate a standard integer vector for data2
+    IntegerVector out(Length(vec));
+    materialize(*inf.info, INTEGER(out), parser(*inf.levels));
 
     R_set_altrep_data2(vec, out);
 
@@ -267,7 +409,7 @@ public:
       return i - 1;
     });
 
-    auto inf = Info(x);
+    auto& inf = Info(x);
 
     auto info = new vroom_vec_info{inf.info->column.subset(idx),
                                    inf.info->num_threads,
@@ -296,6 +438,7 @@ public:
 
     // altinteger
     R_set_altinteger_Elt_method(class_t, factor_Elt);
+    R_set_altinteger_Get_region_method(class_t, Get_region);
   }
 };
 
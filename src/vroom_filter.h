@@ -0,0 +1,256 @@
+#pragma once
+
+#include "vroom_chr.h"
+#include "vroom_date.h"
+#include "vroom_dbl.h"
+#include "vroom_dttm.h"
+#include "vroom_fct.h"
+#include "vroom_int.h"
+#include "vroom_lgl.h"
+#include "vroom_num.h"
+#include "vroom_time.h"
+
+#include <Rcpp.h>
+
+enum filter_op {
+  FILTER_EQ,
+  FILTER_NE,
+  FILTER_LT,
+  FILTER_LE,
+  FILTER_GT,
+  FILTER_GE
+};
+
+filter_op parse_filter_op(const std::string& op) {
+  if (op == "==") {
+    return FILTER_EQ;
+  }
+  if (op == "!=") {
+    return FILTER_NE;
+  }
+  if (op == "<") {
+    return FILTER_LT;
+  }
+  if (op == "<=") {
+    return FILTER_LE;
+  }
+  if (op == ">") {
+    return FILTER_GT;
+  }
+  if (op == ">=") {
+    return FILTER_GE;
+  }
+  Rcpp::stop("Unknown filter operator '%s'", op);
+}
+
+// Missing values never match, like `which()` in R
+template <typename T> bool compare(filter_op op, T x, double value) {
+  if (is_na(x)) {
+    return false;
+  }
+  switch (op) {
+  case FILTER_EQ:
+    return x == value;
+  case FILTER_NE:
+    return x != value;
+  case FILTER_LT:
+    return x < value;
+  case FILTER_LE:
+    return x <= value;
+  case FILTER_GT:
+    return x > value;
+  case FILTER_GE:
+    return x >= value;
+  }
+  return false;
+}
+
+// The (1 based) indices of the rows for which `pred` is true. Each thread
+// tests its own rows, and the results are concatenated in order.
+template <typename P>
+Rcpp::IntegerVector filter_rows(const vroom_vec_info& info, P pred) {
+  size_t n = info.column.size();
+  std::vector<std::vector<int> > rows(info.num_threads);
+
+  parallel_for(
+      n,
+      [&](size_t start, size_t end, size_t id) {
+        pred(info.column.slice(start, end), start, rows[id]);
+      },
+      info.num_threads);
+
+  size_t total = 0;
+  for (const auto& r : rows) {
+    total += r.size();
+  }
+
+  Rcpp::IntegerVector out(total);
+  auto it = out.begin();
+  for (const auto& r : rows) {
+    it = std::copy(r.begin(), r.end(), it);
+  }
+  return out;
+}
+
+// Parse the values a chunk at a time with `fill` and compare each to `value`
+template <typename T, typename F>
+Rcpp::IntegerVector
+filter_values(const vroom_vec_info& info, F fill, filter_op op, double value) {
+  return filter_rows(
+      info,
+      [&](const index_collection::column& col,
+          size_t start,
+          std::vector<int>& out) {
+        const size_t chunk_size = 1024;
+        T values[chunk_size];
+        size_t n = col.size();
+        for (size_t i = 0; i < n; i += chunk_size) {
+          size_t chunk_end = std::min(i + chunk_size, n);
+          fill(col.slice(i, chunk_end), values);
+          for (size_t j = 0; j < chunk_end - i; ++j) {
+            if (compare(op, values[j], value)) {
+              out.push_back(start + i + j + 1);
+            }
+          }
+        }
+      });
+}
+
+// Compare the raw bytes of each cell to `value`, which is converted to the
+// encoding of the file. Cells matching one of the NA strings never match.
+Rcpp::IntegerVector
+filter_strings(const vroom_vec_info& info, filter_op op, SEXP value) {
+  if (op != FILTER_EQ && op != FILTER_NE) {
+    Rcpp::stop("Only `==` and `!=` can be used to filter character vectors");
+  }
+
+  Iconv to_file("UTF-8", info.locale->encoding_);
+  const char* utf8 = Rf_translateCharUTF8(value);
+  std::string needle = to_file.makeString(utf8, utf8 + strlen(utf8));
+
+  auto nas = Rcpp::as<std::vector<std::string> >(*info.na);
+  bool equal = op == FILTER_EQ;
+
+  return filter_rows(
+      info,
+      [&](const index_collection::column& col,
+          size_t start,
+          std::vector<int>& out) {
+        size_t i = start;
+        col.for_each([&](const string& str) {
+          ++i;
+          if ((str == needle) == equal && !matches(str, nas)) {
+            out.push_back(i);
+          }
+        });
+      });
+}
+
+// Character vectors compare raw bytes, factors compare the code of each value
+// to the code of `value`.
+SEXP filter_strings(SEXP x, filter_op op, SEXP value) {
+  if (value == NA_STRING) {
+    return Rcpp::IntegerVector();
+  }
+
+  if (R_altrep_inherits(x, vroom_chr::class_t)) {
+    return filter_strings(vroom_vec::Info(x), op, value);
+  }
+
+  if (op != FILTER_EQ && op != FILTER_NE) {
+    return R_NilValue;
+  }
+
+  SEXP levels = Rf_getAttrib(x, R_LevelsSymbol);
+  const char* str = Rf_translateCharUTF8(value);
+  double code = NA_REAL;
+  for (R_xlen_t i = 0; i < Rf_xlength(levels); ++i) {
+    SEXP level = STRING_ELT(levels, i);
+    if (level != NA_STRING && strcmp(Rf_translateCharUTF8(level), str) == 0) {
+      code = i + 1;
+      break;
+    }
+  }
+  if (ISNAN(code)) {
+    if (op == FILTER_EQ) {
+      return Rcpp::IntegerVector();
+    }
+    return R_NilValue;
+  }
+
+  auto& inf = vroom_fct::Info(x);
+  return filter_values<int>(*inf.info, vroom_fct::parser(*inf.levels), op, code);
+}
+
+// Returns NULL if `x` is not a lazy vroom vector, or is already
+// materialized, in which case the filter should be done in R.
+SEXP vroom_filter(SEXP x, const std::string& op_str, SEXP value) {
+#ifdef HAS_ALTREP
+  if (!ALTREP(x) || R_altrep_data2(x) != R_NilValue) {
+    return R_NilValue;
+  }
+
+  filter_op op = parse_filter_op(op_str);
+
+  if (R_altrep_inherits(x, vroom_chr::class_t) ||
+      R_altrep_inherits(x, vroom_fct::class_t)) {
+    Rcpp::CharacterVector str(value);
+    return filter_strings(x, op, str[0]);
+  }
+
+  // Other types of values are compared using R's rules for coercion
+  if (TYPEOF(value) != REALSXP && TYPEOF(value) != INTSXP &&
+      TYPEOF(value) != LGLSXP) {
+    return R_NilValue;
+  }
+
+  double val = Rcpp::NumericVector(value)[0];
+  if (ISNAN(val)) {
+    return Rcpp::IntegerVector();
+  }
+
+  if (R_altrep_inherits(x, vroom_dbl::class_t)) {
+    return filter_values<double>(
+        vroom_vec::Info(x), vroom_dbl::Parse, op, val);
+  }
+  if (R_altrep_inherits(x, vroom_int::class_t)) {
+    return filter_values<int>(vroom_vec::Info(x), vroom_int::Parse, op, val);
+  }
+  if (R_altrep_inherits(x, vroom_num::class_t)) {
+    auto& inf = vroom_vec::Info(x);
+    return filter_values<double>(
+        inf, vroom_num::parser(*inf.locale), op, val);
+  }
+#if R_VERSION >= R_Version(3, 6, 0)
+  if (R_altrep_inherits(x, vroom_lgl::class_t)) {
+    return filter_values<int>(vroom_vec::Info(x), vroom_lgl::Parse, op, val);
+  }
+#endif
+  if (R_altrep_inherits(x, vroom_dttm::class_t)) {
+    if (!Rf_inherits(value, "POSIXct")) {
+      return R_NilValue;
+    }
+    auto inf = vroom_dttm::Info(x);
+    return filter_values<double>(
+        *inf->info, vroom_dttm::parser<parse_dttm>(*inf), op, val);
+  }
+  if (R_altrep_inherits(x, vroom_date::class_t)) {
+    if (!Rf_inherits(value, "Date")) {
+      return R_NilValue;
+    }
+    auto inf = vroom_dttm::Info(x);
+    return filter_values<double>(
+        *inf->info, vroom_dttm::parser<parse_date>(*inf), op, val);
+  }
+  if (R_altrep_inherits(x, vroom_time::class_t)) {
+    if (!Rf_inherits(value, "hms")) {
+      return R_NilValue;
+    }
+    auto inf = vroom_dttm::Info(x);
+    return filter_values<double>(
+        *inf->info, vroom_dttm::parser<parse_time>(*inf), op, val);
+  }
+#endif
+
+  return R_NilValue;
+}
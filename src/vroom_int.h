@@ -35,9 +35,9 @@ Rcpp::IntegerVector read_int(vroom_vec_info* info) {
       n,
       [&](size_t start, size_t end, size_t id) {
         size_t i = start;
-        for (const auto& str : info->column.slice(start, end)) {
+        info->column.slice(start, end).for_each([&](const string& str) {
           out[i++] = strtoi(str.begin(), str.end());
-        }
+        });
       },
       info->num_threads);
 
@@ -89,7 +89,9 @@ public:
       return data2;
     }
 
-    auto out = read_int(&Info(vec));
+    auto& inf = Info(vec);
+    Rcpp::IntegerVector out(inf.column.size());
+    materialize(inf, INTEGER(out), Parse);
     R_set_altrep_data2(vec, out);
 
     // Once we have materialized we no longer need the info
@@ -98,6 +100,13 @@ public:
     return out;
   }
 
+  // Parse a slice of the column into `out`
+  static void Parse(const index_collection::column& col, int* out) {
+    col.for_each([&](const string& str) {
+      *out++ = strtoi(str.begin(), str.end());
+    });
+  }
+
   // the element at the index `i`
   static int int_Elt(SEXP vec, R_xlen_t i) {
     SEXP data2 = R_altrep_data2(vec);
@@ -105,9 +114,76 @@ public:
       return INTEGER(data2)[i];
     }
 
-    auto str = vroom_vec::Get(vec, i);
+    return get_elt<int>(Info(vec), i, Parse);
+  }
+
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, int* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return INTEGER_GET_REGION(data2, start, size, buf);
+    }
+
+    return get_region(Info(vec), start, size, buf, Parse);
+  }
+
+  // Summaries are only computed lazily if the vector is not yet materialized,
+  // otherwise returning NULL uses R's default method.
+  static SEXP Sum(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<int>(Info(vec), Parse);
+    if (summary.n_na > 0 && !narm) {
+      return Rf_ScalarInteger(NA_INTEGER);
+    }
+    // Let R handle (and warn about) integer overflow
+    if (summary.sum > INT_MAX || summary.sum <= INT_MIN) {
+      return nullptr;
+    }
+    return Rf_ScalarInteger(summary.sum);
+  }
+
+  static SEXP Min(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<int>(Info(vec), Parse);
+    if (summary.n_na > 0 && !narm) {
+      return Rf_ScalarInteger(NA_INTEGER);
+    }
+    if (summary.n == 0) {
+      return nullptr;
+    }
+    return Rf_ScalarInteger(summary.min);
+  }
+
+  static SEXP Max(SEXP vec, Rboolean narm) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return nullptr;
+    }
+    auto& summary = get_summary<int>(Info(vec), Parse);
+    if (summary.n_na > 0 && !narm) {
+      return Rf_ScalarInteger(NA_INTEGER);
+    }
+    if (summary.n == 0) {
+      return nullptr;
+    }
+    return Rf_ScalarInteger(summary.max);
+  }
+
+  static int No_NA(SEXP vec) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return 0;
+    }
+    return get_summary<int>(Info(vec), Parse).n_na == 0;
+  }
 
-    return strtoi(str.begin(), str.end());
+  static int Is_sorted(SEXP vec) {
+    if (R_altrep_data2(vec) != R_NilValue) {
+      return UNKNOWN_SORTEDNESS;
+    }
+    return get_summary<int>(Info(vec), Parse).sortedness();
   }
 
   static void* Dataptr(SEXP vec, Rboolean writeable) {
@@ -129,6 +205,12 @@ public:
 
     // altinteger
     R_set_altinteger_Elt_method(class_t, int_Elt);
+    R_set_altinteger_Get_region_method(class_t, Get_region);
+    R_set_altinteger_Sum_method(class_t, Sum);
+    R_set_altinteger_Min_method(class_t, Min);
+    R_set_altinteger_Max_method(class_t, Max);
+    R_set_altinteger_No_NA_method(class_t, No_NA);
+    R_set_altinteger_Is_sorted_method(class_t, Is_sorted);
   }
 };
 
@@ -1,41 +1,61 @@
-#include <Rcpp.h>
+#pragma once
 
-const static char* const true_values[] = {
-    "T", "t", "True", "TRUE", "true", (char*)NULL};
-const static char* const false_values[] = {
-    "F", "f", "False", "FALSE", "false", (char*)NULL};
+#include "altrep.h"
 
-inline bool isTrue(const char* start, const char* end) {
-  size_t len = end - start;
+#include "vroom_vec.h"
 
-  for (int i = 0; true_values[i]; i++) {
-    size_t true_len = strlen(true_values[i]);
-    if (true_len == len && strncmp(start, true_values[i], len) == 0) {
-      return true;
-    }
-  }
-  return false;
-}
-inline bool isFalse(const char* start, const char* end) {
-  size_t len = end - start;
+#include <Rcpp.h>
 
-  for (int i = 0; false_values[i]; i++) {
-    if (strlen(false_values[i]) == len &&
-        strncmp(start, false_values[i], len) == 0) {
-      return true;
-    }
-  }
-  return false;
+#include <cstdint>
+#include <cstring>
+
+static inline uint32_t load4(const char* p) {
+  uint32_t out;
+  std::memcpy(&out, p, sizeof(out));
+  return out;
 }
 
+// The accepted true values are "T", "t", "True", "TRUE", "true" and "1", the
+// false values the same with "F", "f", "False", "FALSE", "false" and "0". The
+// length of a value and its first byte identify the candidates, so each cell
+// is compared against at most three fixed size words.
 inline int parse_logical(const char* start, const char* end) {
   auto len = end - start;
 
-  if (isTrue(start, end) || (len == 1 && *start == '1')) {
-    return true;
+  switch (len) {
+  case 1:
+    switch (*start) {
+    case 'T':
+    case 't':
+    case '1':
+      return true;
+    case 'F':
+    case 'f':
+    case '0':
+      return false;
+    }
+    break;
+  case 4: {
+    if (*start != 'T' && *start != 't') {
+      break;
+    }
+    uint32_t val = load4(start);
+    if (val == load4("True") || val == load4("TRUE") || val == load4("true")) {
+      return true;
+    }
+    break;
+  }
+  case 5: {
+    if (*start != 'F' && *start != 'f') {
+      break;
+    }
+    // "False" and "false" only differ in the first byte
+    uint32_t val = load4(start + 1);
+    if (val == load4("alse") || (*start == 'F' && val == load4("ALSE"))) {
+      return false;
+    }
+    break;
   }
-  if (isFalse(start, end) || (len == 1 && *start == '0')) {
-    return false;
   }
   return NA_LOGICAL;
 }
@@ -50,11 +70,128 @@ Rcpp::LogicalVector read_lgl(vroom_vec_info* info) {
       n,
       [&](size_t start, size_t end, size_t id) {
         auto i = start;
-        for (const auto& str : info->column.slice(start, end)) {
+        info->column.slice(start, end).for_each([&](const string& str) {
           out[i++] = parse_logical(str.begin(), str.end());
-        }
+        });
       },
       info->num_threads);
 
   return out;
 }
+
+// ALTLOGICAL classes were added in R 3.6
+#if defined(HAS_ALTREP) && R_VERSION >= R_Version(3, 6, 0)
+
+class vroom_lgl : public vroom_vec {
+
+public:
+  static R_altrep_class_t class_t;
+
+  static SEXP Make(vroom_vec_info* info) {
+
+    SEXP out = PROTECT(R_MakeExternalPtr(info, R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(out, vroom_vec::Finalize, FALSE);
+
+    SEXP res = R_new_altrep(class_t, out, R_NilValue);
+
+    UNPROTECT(1);
+
+    MARK_NOT_MUTABLE(res); /* force duplicate on modify */
+
+    return res;
+  }
+
+  // ALTREP methods -------------------
+
+  // What gets printed when .Internal(inspect()) is used
+  static Rboolean Inspect(
+      SEXP x,
+      int pre,
+      int deep,
+      int pvec,
+      void (*inspect_subtree)(SEXP, int, int, int)) {
+    Rprintf(
+        "vroom_lgl (len=%d, materialized=%s)\n",
+        Length(x),
+        R_altrep_data2(x) != R_NilValue ? "T" : "F");
+    return TRUE;
+  }
+
+  // ALTLOGICAL methods -----------------
+
+  static SEXP Materialize(SEXP vec) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return data2;
+    }
+
+    auto& inf = Info(vec);
+    Rcpp::LogicalVector out(inf.column.size());
+    materialize(inf, LOGICAL(out), Parse);
+    R_set_altrep_data2(vec, out);
+
+    // Once we have materialized we no longer need the info
+    Finalize(R_altrep_data1(vec));
+
+    return out;
+  }
+
+  // Parse a slice of the column into `out`
+  static void Parse(const index_collection::column& col, int* out) {
+    col.for_each([&](const string& str) {
+      *out++ = parse_logical(str.begin(), str.end());
+    });
+  }
+
+  // the element at the index `i`
+  static int lgl_Elt(SEXP vec, R_xlen_t i) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return LOGICAL(data2)[i];
+    }
+
+    return get_elt<int>(Info(vec), i, Parse);
+  }
+
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, int* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return LOGICAL_GET_REGION(data2, start, size, buf);
+    }
+
+    return get_region(Info(vec), start, size, buf, Parse);
+  }
+
+  static void* Dataptr(SEXP vec, Rboolean writeable) {
+    return STDVEC_DATAPTR(Materialize(vec));
+  }
+
+  // -------- initialize the altrep class with the methods above
+  static void Init(DllInfo* dll) {
+    vroom_lgl::class_t = R_make_altlogical_class("vroom_lgl", "vroom", dll);
+
+    // altrep
+    R_set_altrep_Length_method(class_t, Length);
+    R_set_altrep_Inspect_method(class_t, Inspect);
+
+    // altvec
+    R_set_altvec_Dataptr_method(class_t, Dataptr);
+    R_set_altvec_Dataptr_or_null_method(class_t, Dataptr_or_null);
+    R_set_altvec_Extract_subset_method(class_t, Extract_subset<vroom_lgl>);
+
+    // altlogical
+    R_set_altlogical_Elt_method(class_t, lgl_Elt);
+    R_set_altlogical_Get_region_method(class_t, Get_region);
+  }
+};
+
+R_altrep_class_t vroom_lgl::class_t;
+
+// Called the package is loaded (needs Rcpp 0.12.18.3)
+// [[Rcpp::init]]
+void init_vroom_lgl(DllInfo* dll) { vroom_lgl::Init(dll); }
+
+#else
+void init_vroom_lgl(DllInfo* dll) {}
+#endif
@@ -7,12 +7,68 @@
 
 #include "parallel.h"
 
+#include <cstdint>
+#include <cstdlib>
+
 using namespace vroom;
 
 enum NumberState { STATE_INIT, STATE_LHS, STATE_RHS, STATE_EXP, STATE_FIN };
 
+// The characters of a number with the grouping marks and any other
+// decoration removed. Kept on the stack unless the number is unusually long.
+class number_buffer {
+  char stack_[64];
+  std::string heap_;
+  size_t size_;
+
+public:
+  number_buffer() : size_(0) {}
+
+  void push_back(char c) {
+    if (size_ < sizeof(stack_) - 1) {
+      stack_[size_++] = c;
+      return;
+    }
+    if (heap_.empty()) {
+      heap_.assign(stack_, size_);
+    }
+    heap_.push_back(c);
+    ++size_;
+  }
+
+  const char* c_str() {
+    if (!heap_.empty()) {
+      return heap_.c_str();
+    }
+    stack_[size_] = '\0';
+    return stack_;
+  }
+};
+
+// Convert the number scanned by parseNumber() with strtod(), copying it into
+// the form strtod() expects. The state machine has already checked the
+// characters, so only the grouping and decimal marks need replacing.
+template <typename Iterator>
+double strtod_number(
+    char decimalMark, char groupingMark, Iterator first, Iterator last) {
+  number_buffer buf;
+  for (; first != last; ++first) {
+    if (*first == groupingMark) {
+      continue;
+    }
+    buf.push_back(*first == decimalMark ? '.' : *first);
+  }
+  return strtod(buf.c_str(), NULL);
+}
+
 // First and last are updated to point to first/last successfully parsed
 // character
+//
+// The digits are accumulated into an integer mantissa as they are scanned.
+// If it and the power of ten it is scaled by are both exactly representable
+// as doubles, one multiplication or division gives the correctly rounded
+// result (Clinger's fast path). Otherwise the number is converted by
+// strtod(), so results are always correctly rounded.
 template <typename Iterator, typename Attr>
 inline bool parseNumber(
     char decimalMark,
@@ -35,10 +91,22 @@ inline bool parseNumber(
     first = cur;
   }
 
-  double sum = 0, denom = 1, exponent = 0;
   NumberState state = STATE_INIT;
   bool seenNumber = false, exp_init = true;
-  double sign = 1.0, exp_sign = 1.0;
+
+  // The value is mantissa * 10^(exponent - scale)
+  uint64_t mantissa = 0;
+  bool exact = true, negative = false, exp_negative = false;
+  int exponent = 0, scale = 0;
+
+  auto add_digit = [&](char c) {
+    seenNumber = true;
+    if (mantissa <= (UINT64_MAX - 9) / 10) {
+      mantissa = mantissa * 10 + (c - '0');
+    } else {
+      exact = false;
+    }
+  };
 
   for (; cur != last; ++cur) {
     if (state == STATE_FIN)
@@ -48,13 +116,12 @@ inline bool parseNumber(
     case STATE_INIT:
       if (*cur == '-') {
         state = STATE_LHS;
-        sign = -1.0;
+        negative = true;
       } else if (*cur == decimalMark) {
         state = STATE_RHS;
       } else if (*cur >= '0' && *cur <= '9') {
-        seenNumber = true;
         state = STATE_LHS;
-        sum = *cur - '0';
+        add_digit(*cur);
       } else {
         goto end;
       }
@@ -67,9 +134,7 @@ inline bool parseNumber(
       } else if (seenNumber && (*cur == 'e' || *cur == 'E')) {
         state = STATE_EXP;
       } else if (*cur >= '0' && *cur <= '9') {
-        seenNumber = true;
-        sum *= 10;
-        sum += *cur - '0';
+        add_digit(*cur);
       } else {
         goto end;
       }
@@ -80,25 +145,23 @@ inline bool parseNumber(
       } else if (seenNumber && (*cur == 'e' || *cur == 'E')) {
         state = STATE_EXP;
       } else if (*cur >= '0' && *cur <= '9') {
-        seenNumber = true;
-        denom *= 10;
-        sum += (*cur - '0') / denom;
+        add_digit(*cur);
+        ++scale;
       } else {
         goto end;
       }
       break;
     case STATE_EXP:
       // negative/positive sign only allowed immediately after 'e' or 'E'
-      if (*cur == '-' && exp_init) {
-        exp_sign = -1.0;
-        exp_init = false;
-      } else if (*cur == '+' && exp_init) {
-        // sign defaults to positive
+      if ((*cur == '-' || *cur == '+') && exp_init) {
         exp_init = false;
+        exp_negative = *cur == '-';
       } else if (*cur >= '0' && *cur <= '9') {
-        exponent *= 10.0;
-        exponent += *cur - '0';
         exp_init = false;
+        // Exponents this large are left to strtod()
+        if (exponent < 10000) {
+          exponent = exponent * 10 + (*cur - '0');
+        }
       } else {
         goto end;
       }
@@ -113,14 +176,28 @@ end:
   // Set last to point to final character used
   last = cur;
 
-  res = sign * sum;
+  if (!seenNumber) {
+    return false;
+  }
 
-  // If the number was in scientific notation, multiply by 10^exponent
-  if (exponent) {
-    res *= pow(10.0, exp_sign * exponent);
+  // The powers of ten which are exact as doubles
+  static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+
+  // An exponent without any digits is ignored, as by strtod()
+  int power = (exp_negative ? -exponent : exponent) - scale;
+  if (exact && mantissa <= (uint64_t(1) << 53) && power >= -22 &&
+      power <= 22) {
+    double value = static_cast<double>(mantissa);
+    value = power < 0 ? value / powers[-power] : value * powers[power];
+    res = negative ? -value : value;
+  } else {
+    res = strtod_number(decimalMark, groupingMark, first, cur);
   }
 
-  return seenNumber;
+  return true;
 }
 
 double parse_num(const string& str, const LocaleInfo& loc) {
@@ -145,9 +222,9 @@ Rcpp::NumericVector read_num(vroom_vec_info* info) {
       n,
       [&](size_t start, size_t end, size_t id) {
         size_t i = start;
-        for (const auto& str : info->column.slice(start, end)) {
+        info->column.slice(start, end).for_each([&](const string& str) {
           out[i++] = parse_num(str, *info->locale);
-        }
+        });
       },
       info->num_threads);
 
@@ -202,12 +279,34 @@ public:
       return REAL(data2)[i];
     }
 
-    auto str = vroom_vec::Get(vec, i);
-    auto& inf = vroom_vec::Info(vec);
+    auto& inf = Info(vec);
+    return get_elt<double>(inf, i, parser(*inf.locale));
+  }
+
+  static R_xlen_t
+  Get_region(SEXP vec, R_xlen_t start, R_xlen_t size, double* buf) {
+    SEXP data2 = R_altrep_data2(vec);
+    if (data2 != R_NilValue) {
+      return REAL_GET_REGION(data2, start, size, buf);
+    }
 
-    return parse_num(str, *inf.locale);
+    auto& inf = Info(vec);
+    return get_region(inf, start, size, buf, parser(*inf.locale));
   }
 
+  // Parses slices of the column into `out`
+  struct parser {
+    const LocaleInfo& locale;
+
+    parser(const LocaleInfo& locale_) : locale(locale_) {}
+
+    void operator()(const index_collection::column& col, double* out) const {
+      col.for_each([&](const string& str) {
+        *out++ = parse_num(str, locale);
+      });
+    }
+  };
+
   // --- Altvec
   static SEXP Materialize(SEXP vec) {
     SEXP data2 = R_altrep_data2(vec);
@@ -215,7 +314,9 @@ public:
       return data2;
     }
 
-    auto out = read_num(&Info(vec));
+    auto& inf = Info(vec);
+    Rcpp::NumericVector out(inf.column.size());
+    materialize(inf, REAL(out), parser(*inf.locale));
     R_set_altrep_data2(vec, out);
 
     // Once we have materialized we no longer need the info
@@ -243,6 +344,7 @@ public:
 
     // altinteger
     R_set_altreal_Elt_method(class_t, real_Elt);
+    R_set_altreal_Get_region_method(class_t, Get_region);
   }
 };
 
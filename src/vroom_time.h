@@ -4,10 +4,16 @@
 
 using namespace vroom;
 
+// Times without an explicit format use the locale's time format
+DateTimeFormat time_format(const vroom_vec_info& info) {
+  return DateTimeFormat(
+      info.format.empty() ? info.locale->timeFormat_ : info.format);
+}
+
 double parse_time(
-    const string& str, DateTimeParser& parser, const std::string& format) {
+    const string& str, DateTimeParser& parser, const DateTimeFormat& format) {
   parser.setDate(str.begin(), str.end());
-  bool res = (format == "") ? parser.parseLocaleTime() : parser.parse(format);
+  bool res = parser.parse(format);
 
   if (res) {
     DateTime dt = parser.makeTime();
@@ -23,14 +29,20 @@ Rcpp::NumericVector read_time(vroom_vec_info* info) {
 
   Rcpp::NumericVector out(n);
 
+  auto format = time_format(*info);
+
   parallel_for(
       n,
       [&](size_t start, size_t end, size_t id) {
         auto i = start;
         DateTimeParser parser(&*info->locale);
-        for (const auto& str : info->column.slice(start, end)) {
-          out[i++] = parse_time(str, parser, info->format);
-        }
+        dttm_cache cache;
+        auto parse = [&](const string& str) {
+          return parse_time(str, parser, format);
+        };
+        info->column.slice(start, end).for_each([&](const string& str) {
+          out[i++] = cache.get(str, parse);
+        });
       },
       info->num_threads,
       true);
@@ -52,8 +64,8 @@ public:
 
     vroom_dttm_info* dttm_info = new vroom_dttm_info;
     dttm_info->info = info;
-    dttm_info->parser =
-        std::unique_ptr<DateTimeParser>(new DateTimeParser(&*info->locale));
+    dttm_info->format = std::unique_ptr<DateTimeFormat>(
+        new DateTimeFormat(time_format(*info)));
 
     SEXP out = PROTECT(R_MakeExternalPtr(dttm_info, R_NilValue, R_NilValue));
     R_RegisterCFinalizerEx(out, vroom_dttm::Finalize, FALSE);
@@ -84,19 +96,6 @@ public:
     return TRUE;
   }
 
-  // the element at the index `i`
-  static double time_Elt(SEXP vec, R_xlen_t i) {
-    SEXP data2 = R_altrep_data2(vec);
-    if (data2 != R_NilValue) {
-      return REAL(data2)[i];
-    }
-
-    auto str = Get(vec, i);
-    auto inf = Info(vec);
-
-    return parse_time(str, *inf->parser, inf->info->format);
-  }
-
   // --- Altvec
   static SEXP Materialize(SEXP vec) {
     SEXP data2 = R_altrep_data2(vec);
@@ -106,7 +105,8 @@ public:
 
     auto inf = Info(vec);
 
-    auto out = read_time(inf->info);
+    Rcpp::NumericVector out(inf->info->column.size());
+    materialize(*inf->info, REAL(out), parser<parse_time>(*inf));
 
     R_set_altrep_data2(vec, out);
 
@@ -134,7 +134,8 @@ public:
     R_set_altvec_Extract_subset_method(class_t, Extract_subset<vroom_time>);
 
     // altreal
-    R_set_altreal_Elt_method(class_t, time_Elt);
+    R_set_altreal_Elt_method(class_t, Elt<parse_time>);
+    R_set_altreal_Get_region_method(class_t, Get_region<parse_time>);
   }
 };
 
@@ -4,6 +4,8 @@
 
 #include <Rcpp.h>
 
+#include "parallel.h"
+
 using namespace vroom;
 
 struct vroom_vec_info {
@@ -12,8 +14,234 @@ struct vroom_vec_info {
   std::shared_ptr<Rcpp::CharacterVector> na;
   std::shared_ptr<LocaleInfo> locale;
   std::string format;
+
+  // The parsed values of a lazy vector, a block_cache<T> created on first
+  // access
+  std::shared_ptr<void> cache;
+
+  // Summary statistics of a lazy vector, a vroom_vec_summary<T> computed the
+  // first time they are needed
+  std::shared_ptr<void> summary;
+};
+
+// Parsed values of a lazy vector, in blocks of `block_size` rows. A block is
+// parsed the first time any of its rows are accessed and then reused, so
+// repeatedly accessing part of a large column does not parse the same cells
+// again, and does not need the whole column to be materialized.
+//
+// Blocks are never evicted, so the cache is unbounded: scanning the whole
+// column caches every block. It is only released when the vector is
+// materialized, which moves the cached blocks into the materialized vector
+// rather than parsing them again.
+//
+// `fill` is called with a slice of the column and where to write its values.
+// Several blocks may be filled at once on different threads, so `fill` should
+// only use state local to each call.
+template <typename T> class block_cache {
+public:
+  static const size_t block_size = 1 << 16;
+
+private:
+  std::vector<std::unique_ptr<T[]> > blocks_;
+
+public:
+  block_cache(size_t size) : blocks_((size + block_size - 1) / block_size) {}
+
+  template <typename F>
+  T get(const index_collection::column& column, size_t i, F fill) {
+    size_t block = i / block_size;
+    if (!blocks_[block]) {
+      fill_block(column, block, fill);
+    }
+    return blocks_[block][i % block_size];
+  }
+
+  // Copy the values [start, start + size) into `buf`
+  template <typename F>
+  void get(
+      const index_collection::column& column,
+      size_t num_threads,
+      size_t start,
+      size_t size,
+      T* buf,
+      F fill) {
+    if (size == 0) {
+      return;
+    }
+
+    std::vector<size_t> missing;
+    for (size_t block = start / block_size;
+         block <= (start + size - 1) / block_size;
+         ++block) {
+      if (!blocks_[block]) {
+        missing.push_back(block);
+      }
+    }
+
+    if (!missing.empty()) {
+      size_t threads = std::min(num_threads, missing.size());
+      parallel_for(
+          missing.size(),
+          [&](size_t begin, size_t end, size_t id) {
+            for (size_t i = begin; i < end; ++i) {
+              fill_block(column, missing[i], fill);
+            }
+          },
+          threads,
+          threads > 1);
+    }
+
+    size_t end = start + size;
+    while (start < end) {
+      const T* block = blocks_[start / block_size].get();
+      size_t offset = start % block_size;
+      size_t n = std::min(end - start, block_size - offset);
+      std::copy(block + offset, block + offset + n, buf);
+      buf += n;
+      start += n;
+    }
+  }
+
+  // Write all values into `out`, copying the cached blocks and parsing the
+  // others straight into `out`. Each cached block is freed once copied.
+  template <typename F>
+  void move_to(
+      const index_collection::column& column,
+      size_t num_threads,
+      T* out,
+      F fill) {
+    size_t threads = std::min(num_threads, blocks_.size());
+    if (threads == 0) {
+      return;
+    }
+    parallel_for(
+        blocks_.size(),
+        [&](size_t begin, size_t end, size_t id) {
+          for (size_t block = begin; block < end; ++block) {
+            size_t start = block * block_size;
+            size_t stop = std::min(start + block_size, column.size());
+            if (blocks_[block]) {
+              const T* values = blocks_[block].get();
+              std::copy(values, values + (stop - start), out + start);
+              blocks_[block].reset();
+            } else {
+              fill(column.slice(start, stop), out + start);
+            }
+          }
+        },
+        threads,
+        threads > 1);
+  }
+
+private:
+  template <typename F>
+  void fill_block(
+      const index_collection::column& column, size_t block, F fill) {
+    size_t start = block * block_size;
+    size_t end = std::min(start + block_size, column.size());
+
+    std::unique_ptr<T[]> values(new T[end - start]);
+    fill(column.slice(start, end), values.get());
+    blocks_[block] = std::move(values);
+  }
+};
+
+inline bool is_na(int x) { return x == NA_INTEGER; }
+inline bool is_na(double x) { return ISNAN(x); }
+
+// Summary statistics of a numeric vector, used by the Sum, Min, Max, No_NA
+// and Is_sorted ALTREP methods. NaN values are counted as NA.
+template <typename T> struct vroom_vec_summary {
+  size_t n;
+  size_t n_na;
+
+  // These are all over the non-NA values
+  long double sum;
+  T min;
+  T max;
+  T first;
+  T last;
+  bool increasing;
+  bool decreasing;
+
+  vroom_vec_summary()
+      : n(0),
+        n_na(0),
+        sum(0),
+        min(0),
+        max(0),
+        first(0),
+        last(0),
+        increasing(true),
+        decreasing(true) {}
+
+  void add(T x) {
+    if (is_na(x)) {
+      ++n_na;
+      return;
+    }
+    if (n == 0) {
+      min = max = first = x;
+    } else {
+      if (x < min) {
+        min = x;
+      } else if (x > max) {
+        max = x;
+      }
+      increasing = increasing && x >= last;
+      decreasing = decreasing && x <= last;
+    }
+    sum += x;
+    last = x;
+    ++n;
+  }
+
+  // Combine with the summary of the values directly after these ones
+  void add(const vroom_vec_summary& next) {
+    n_na += next.n_na;
+    if (next.n == 0) {
+      return;
+    }
+    if (n == 0) {
+      size_t na = n_na;
+      *this = next;
+      n_na = na;
+      return;
+    }
+    if (next.min < min) {
+      min = next.min;
+    }
+    if (next.max > max) {
+      max = next.max;
+    }
+    increasing = increasing && next.increasing && next.first >= last;
+    decreasing = decreasing && next.decreasing && next.first <= last;
+    sum += next.sum;
+    last = next.last;
+    n += next.n;
+  }
+
+  int sortedness() const {
+    if (n_na > 0) {
+      return UNKNOWN_SORTEDNESS;
+    }
+    if (increasing) {
+      return SORTED_INCR;
+    }
+    if (decreasing) {
+      return SORTED_DECR;
+    }
+    return KNOWN_UNSORTED;
+  }
 };
 
+template <typename T> block_cache<T>& cached_values(vroom_vec_info& info) {
+  if (!info.cache) {
+    info.cache = std::make_shared<block_cache<T> >(info.column.size());
+  }
+  return *static_cast<block_cache<T>*>(info.cache.get());
+}
+
 #ifdef HAS_ALTREP
 
 class vroom_vec {
@@ -62,6 +290,73 @@ public:
     return STDVEC_DATAPTR(data2);
   }
 
+  // The value at `i`, parsing the block it is in with `fill` if needed
+  template <typename T, typename F>
+  static T get_elt(vroom_vec_info& info, R_xlen_t i, F fill) {
+    return cached_values<T>(info).get(info.column, i, fill);
+  }
+
+  // Copy up to `size` values starting at `start` into `buf`, for use by the
+  // Get_region methods. Any blocks not yet parsed are parsed with `fill`.
+  template <typename T, typename F>
+  static R_xlen_t get_region(
+      vroom_vec_info& info, R_xlen_t start, R_xlen_t size, T* buf, F fill) {
+    R_xlen_t n = info.column.size();
+    if (start >= n) {
+      return 0;
+    }
+    size = std::min(size, n - start);
+
+    cached_values<T>(info).get(
+        info.column, info.num_threads, start, size, buf, fill);
+
+    return size;
+  }
+
+  // Write all values into `out`, for use by the Materialize methods. Blocks
+  // already cached are copied rather than parsed again, and the cache is then
+  // released, so the values are not kept twice.
+  template <typename T, typename F>
+  static void materialize(vroom_vec_info& info, T* out, F fill) {
+    cached_values<T>(info).move_to(info.column, info.num_threads, out, fill);
+    info.cache.reset();
+  }
+
+  // The summary of all values, computed in parallel on first use. Values are
+  // parsed with `fill` a chunk at a time, so the column is never
+  // materialized.
+  template <typename T, typename F>
+  static const vroom_vec_summary<T>& get_summary(vroom_vec_info& info, F fill) {
+    if (!info.summary) {
+      size_t n = info.column.size();
+      std::vector<vroom_vec_summary<T> > summaries(info.num_threads);
+
+      parallel_for(
+          n,
+          [&](size_t start, size_t end, size_t id) {
+            const size_t chunk_size = 1024;
+            T values[chunk_size];
+            auto& summary = summaries[id];
+            while (start < end) {
+              size_t chunk_end = std::min(start + chunk_size, end);
+              fill(info.column.slice(start, chunk_end), values);
+              for (size_t i = 0; i < chunk_end - start; ++i) {
+                summary.add(values[i]);
+              }
+              start = chunk_end;
+            }
+          },
+          info.num_threads);
+
+      auto out = std::make_shared<vroom_vec_summary<T> >();
+      for (const auto& summary : summaries) {
+        out->add(summary);
+      }
+      info.summary = out;
+    }
+    return *static_cast<vroom_vec_summary<T>*>(info.summary.get());
+  }
+
   template <typename T>
   static SEXP Extract_subset(SEXP x, SEXP indx, SEXP call) {
     SEXP data2 = R_altrep_data2(x);